@@ -3,7 +3,9 @@
 #include <cstdlib>
 #include <fmt/format.h>
 #include <lsp/connection.h>
-#include <lsp/io/standardio.h>
+#include <lsp/io/stream.h>
+#include <unistd.h>
+#include <cerrno>
 #include <stdio.h>
 #include <dlfcn.h>
 #include <filesystem>
@@ -14,6 +16,8 @@
 #include <CLI/CLI.hpp>
 #include <logger.h>
 #include <lsp.h>
+#include <query.h>
+#include <optional>
 #include <vector>
 
 struct MyArgs {
@@ -26,17 +30,76 @@ struct MyArgs {
     bool generateAll {false};
 
     bool compileAll {true};
+    bool check {false};
     bool lsp{false};
+
+    std::string lto {};
+    unsigned optLevel {0};
+    bool noIncremental {false};
+    bool noTreeShaking {false};
+    bool watch {false};
+
+    std::string target {};
+    std::string cpu {};
+    std::string features {};
+
+    std::string profileGenerate {};
+    std::string profileUse {};
+
+    bool emitObjects {false};
+    unsigned codegenThreads {1};
+
+    size_t memoryBudget {0};
+    bool memoryReport {false};
 };
 
 NOVA_LOG_DEF("Main");
 
+// The language server speaks over stdout, so a single log line there corrupts the protocol.
+// Not every logger can be pointed elsewhere (Nova Core's, LLVM's), so fd 1 itself is moved
+// to stderr and the protocol keeps a private duplicate of the original stdout.
+class ProtocolIO final : public lsp::io::Stream {
+public:
+    ProtocolIO() : _out(::dup(STDOUT_FILENO)) {
+        std::fflush(stdout);
+        std::cout.flush();
+        ::dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
+    ~ProtocolIO() override {
+        if (_out >= 0) ::close(_out);
+    }
+
+    void read(char* buffer, std::size_t size) override {
+        while (size > 0) {
+            const ssize_t count = ::read(STDIN_FILENO, buffer, size);
+            if (count < 0 && errno == EINTR) continue;
+            // The client closed its end, there is nobody left to serve
+            if (count <= 0) std::exit(EXIT_SUCCESS);
+            buffer += count;
+            size -= static_cast<std::size_t>(count);
+        }
+    }
+
+    void write(const char* data, std::size_t size) override {
+        while (size > 0) {
+            const ssize_t count = ::write(_out, data, size);
+            if (count < 0 && errno == EINTR) continue;
+            if (count < 0) std::exit(EXIT_FAILURE);
+            data += count;
+            size -= static_cast<std::size_t>(count);
+        }
+    }
+
+private:
+    int _out;
+};
+
 
 int main(int argc, char** argv) {
 
     MyArgs args{};
 
-    NCINFO("Welcome to Nova Language!");
     CLI::App app{"Nova Language Compiler"};
     argv = app.ensure_utf8(argv);
 
@@ -50,21 +113,94 @@ int main(int argc, char** argv) {
     });
 
     compiler->add_option("-c, --config", args.configPath, "Path to configuration file")->check(CLI::ExistingFile);
-    compiler->add_flag("--parse", args.compileAll, "Compile all projects specified in the configuration file");
+    compiler->add_flag("--check", args.check, "Only parse and validate the sources, no LLVM and no output files");
+    compiler->add_flag("--parse", args.check, "Alias for --check");
     compiler->add_flag("--compile", args.compileAll, "Compile all projects specified in the configuration file");
+    compiler->add_option("--lto", args.lto, "Link-time optimization mode, overrides nc.conf")->check(CLI::IsMember({"none", "full", "thin", "auto"}));
+    compiler->add_option("-O, --opt-level", args.optLevel, "Optimization level")->check(CLI::Range(0, 3));
+    compiler->add_option("--target", args.target, "Target triple, 'native' for the host (default)");
+    compiler->add_option("--cpu", args.cpu, "Target CPU, 'native' detects the host CPU and its features");
+    compiler->add_option("--features", args.features, "Extra target features, e.g. +avx2,-avx512f");
+    compiler->add_flag("--profile-generate{default_%m.profraw}", args.profileGenerate, "Instrument for PGO, optionally =<path> for the raw profiles (link with clang -fprofile-generate)");
+    compiler->add_option("--profile-use", args.profileUse, "Optimize with a profile merged by llvm-profdata")->check(CLI::ExistingFile);
+    compiler->add_flag("--emit-obj", args.emitObjects, "Also generate machine code (<file>.o) for every IR file");
+    compiler->add_option("--codegen-threads", args.codegenThreads, "Split large modules and generate their machine code on this many threads, 0 for all cores");
+    compiler->add_option("--memory-budget", args.memoryBudget, "Heap size in MB after which the LLVM context is recycled, overrides nc.conf");
+    compiler->add_flag("--memory-report", args.memoryReport, "Print context and module memory usage after every build");
+    compiler->add_flag("--no-incremental", args.noIncremental, "Regenerate every function instead of reusing unchanged ones");
+    compiler->add_flag("--no-tree-shaking", args.noTreeShaking, "Generate every function of an executable, even the ones main can not reach");
+    compiler->add_flag("-w, --watch", args.watch, "Keep running and rebuild when a source file changes");
 
 
     CLI11_PARSE(app, argc, argv);
 
+    // Has to happen before anything is logged, including the banner and the config warnings of LSP(...)
+    std::optional<ProtocolIO> protocol;
+    if (args.lsp) {
+        protocol.emplace();
+        logStream = &std::cerr;
+    }
+
+    NCINFO("Welcome to Nova Language!");
+
     if (args.compiler) NCINFO("Compiler usage was requested.");
     if (args.compiler) {
         Nova::Compiler::Compiler compiler;
 
+        Nova::Compiler::BuildOptions options;
+        options.optLevel = args.optLevel;
+        options.incremental = !args.noIncremental;
+        options.treeShaking = !args.noTreeShaking;
+        options.target.triple = args.target;
+        options.target.cpu = args.cpu;
+        options.target.features = args.features;
+        options.profileGenerate = args.profileGenerate;
+        options.profileUse = args.profileUse;
+        options.emitObjects = args.emitObjects || args.codegenThreads != 1;
+        options.codegenThreads = args.codegenThreads;
+        if (args.memoryBudget != 0) options.memoryBudgetMB = args.memoryBudget;
+        if (!options.profileGenerate.empty() && !options.profileUse.empty()) {
+            NCERROR("--profile-generate and --profile-use can not be combined");
+            return EXIT_FAILURE;
+        }
+        if (args.lto == "none") options.lto = Nova::Compiler::LTOMode::None;
+        else if (args.lto == "full") options.lto = Nova::Compiler::LTOMode::Full;
+        else if (args.lto == "thin") options.lto = Nova::Compiler::LTOMode::Thin;
+        else if (args.lto == "auto") options.lto = Nova::Compiler::LTOMode::Auto;
+        compiler.setOptions(options);
+
+        // Syntax and semantic errors only, for pre-commit hooks and CI linting
+        if (args.check) {
+            const size_t errors = compiler.checkAll();
+            NCINFO("Goodbye.");
+            return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
         if (args.generateAll) compiler.generateAll("./");
         if (args.compileAll) {
             compiler.generateAll("./");
             // Then compile
         }
+        if (args.memoryReport) compiler.reportMemoryUsage();
+
+        // Rebuilds reuse the in-memory module cache and the query engine, only edited functions
+        // go through codegen again and only edited files are parsed again
+        if (args.watch) {
+            NCINFO("Watching for changes...");
+            auto& queries = compiler.queries();
+            for (const auto& project : compiler.projects()) {
+                for (const auto& file : project.files) queries.text(file);
+            }
+
+            while (true) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(250));
+                // Saves that leave the contents as they were do not start a build
+                if (queries.refresh()) {
+                    compiler.generateAll("./");
+                    if (args.memoryReport) compiler.reportMemoryUsage();
+                }
+            }
+        }
 
         // std::string test = "var int x = 2 + 2;ret 0;x = test();";
 
@@ -80,7 +216,7 @@ int main(int argc, char** argv) {
     }else if (args.lsp) {
         NCINFO("LSP usage was requested.");
         
-        auto connection = lsp::Connection(lsp::io::standardIO());
+        auto connection = lsp::Connection(*protocol);
         auto messageHandler = lsp::MessageHandler(connection);
 
         auto lsp = Nova::Compiler::LSP(messageHandler);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Nova::Compiler {
+
+    // Takes finished output buffers off the compile thread and writes them in the
+    // background: batched through io_uring when the kernel allows it, otherwise
+    // through a small thread pool. Unchanged files are left alone and every write
+    // goes to a temporary file that is renamed over the target.
+    class ArtifactWriter {
+    public:
+        struct Stats {
+            size_t written = 0;
+            size_t unchanged = 0;
+            size_t failed = 0;
+        };
+
+        ArtifactWriter();
+        ~ArtifactWriter();
+
+        ArtifactWriter(const ArtifactWriter&) = delete;
+        ArtifactWriter& operator=(const ArtifactWriter&) = delete;
+
+        // Never blocks on disk, the buffer is owned by the writer afterwards
+        void submit(std::filesystem::path path, std::string contents);
+
+        // Waits until everything submitted so far is on disk
+        void flush();
+
+        // Counts since the last call
+        Stats takeStats();
+
+        bool usesIoUring() const { return _ring != nullptr; }
+
+    private:
+        struct Artifact {
+            std::filesystem::path path;
+            std::string contents;
+        };
+
+        void run();
+        void writeBatch(std::vector<Artifact>& batch);
+        void writeBatchIoUring(std::vector<Artifact*>& jobs);
+        bool writeFile(const Artifact& artifact);
+        void finish(const Artifact& artifact, bool ok);
+
+        static bool unchanged(const Artifact& artifact);
+        static std::filesystem::path temporaryPath(const std::filesystem::path& path);
+
+        std::mutex _mutex;
+        std::condition_variable _wake;     // Work arrived or shutting down
+        std::condition_variable _idle;     // Everything submitted is on disk
+        std::deque<Artifact> _queue;
+        size_t _pending = 0;               // Submitted but not finished
+        bool _stop = false;
+        Stats _stats;
+
+        void* _ring = nullptr;             // io_uring instance when available
+        std::vector<std::thread> _threads; // One batching thread with io_uring, a pool without
+    };
+
+} // namespace Nova::Compiler
@@ -5,15 +5,27 @@
 #include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
+#include <llvm/Pass.h>
+#include <llvm/Support/PGOOptions.h>
+#include <llvm/Target/TargetMachine.h>
+#include <cstdint>
+#include <memory>
 #include <optional>
 #include <string_view>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <filesystem>
 #include <Nova/Core/core.h>
+#include "artifact_writer.h"
 
 namespace Nova::Compiler {
 
+    class InterfaceFile;
+    class QueryEngine;
+    class SourceDiscovery;
+
     // ============================================================================
     // Project Management Types
     // ============================================================================
@@ -28,12 +40,59 @@ namespace Nova::Compiler {
         Dynamic
     };
 
+    enum class LTOMode {
+        None,   // One artifact per source file
+        Full,   // Link all modules of a project into one and optimize it as a whole
+        Thin,   // Per-file bitcode with summaries, cross-module work is left to the linker
+        Auto    // Full for small projects, Thin for big ones
+    };
+
     struct Project {
         std::string name;
         std::vector<std::string> files;    // Source files for IR generation
         std::vector<std::string> headers;  // Headers for class organization and function definitions
         ProjectType type;
         std::optional<LibraryType> libType;
+        std::optional<LTOMode> lto;        // Per-project override from nc.conf
+        std::vector<std::string> dependencies; // Library projects used through their interface (packages)
+        std::filesystem::path sourceDir;   // Per-file outputs mirror the tree below it, empty: below the files' common parent
+    };
+
+    // Code generation target, empty fields fall back to the host
+    struct TargetSpec {
+        std::string triple;    // "native" or empty for the host triple
+        std::string cpu;       // "native" for the host CPU, empty for generic
+        std::string features;  // Extra features, e.g. "+avx2,-avx512f"
+        std::string os;        // targetOS from nc.conf (linux, windows, macos)
+    };
+
+    // Options coming from the command line, these override nc.conf
+    struct BuildOptions {
+        TargetSpec target;
+        std::optional<LTOMode> lto;
+        unsigned optLevel = 0;             // 0-3, same meaning as -O0..-O3
+        bool incremental = true;           // Reuse unchanged functions between builds
+        std::string profileGenerate;       // Instrument for PGO, raw profiles are written to this path
+        std::string profileUse;            // Merged .profdata used to optimize
+        std::optional<size_t> memoryBudgetMB; // Heap size that triggers context recycling, overrides memoryBudget in nc.conf
+        bool treeShaking = true;           // Executables skip functions main can not reach
+        bool emitObjects = false;          // Machine code next to the IR (<stem>.o)
+        unsigned codegenThreads = 1;       // Large modules are split into this many codegen partitions, 0 for every core
+    };
+
+    // Per-file state kept between builds so unchanged functions are not generated again
+    struct ModuleCache {
+        std::unique_ptr<llvm::Module> module;
+        uint64_t salt = 0;                                     // Hash of build options and every declaration in the file
+        std::unordered_map<std::string, uint64_t> fingerprints; // Function name -> declaration + body hash
+        std::vector<std::string> dirty;                        // Functions regenerated by the last build
+        std::string bitcode;                                   // Serialized module while its context is being recycled
+    };
+
+    // Named in-memory object file, e.g. a member of a library archive
+    struct ObjectBuffer {
+        std::string name;
+        std::string bytes;
     };
 
     // ============================================================================
@@ -63,6 +122,8 @@ namespace Nova::Compiler {
 
         std::string file;
         std::string snippet;
+
+        bool operator==(const ParseError&) const = default;
     };
 
     enum class TokenType {
@@ -93,6 +154,66 @@ namespace Nova::Compiler {
           std::vector<Token> tokens;   
     };
 
+    // Expression tree built by precedence climbing over a statement's tokens
+    enum class ExprKind {
+        Number,
+        Variable,
+        Call,
+        Negate,
+        Binary,
+        Assign
+    };
+
+    struct Expr {
+        ExprKind kind;
+        std::string value;                 // Literal text, variable or callee name
+        TokenType op = TokenType::Unknown; // Operator of a Binary
+        std::vector<Expr> operands;        // Binary: lhs, rhs / Negate, Assign: value / Call: arguments
+    };
+
+    enum class StatementKind {
+        Declare,    // var [type] name = expr / const [type] name = expr
+        Return,     // ret [expr]
+        Expression  // Anything else, e.g. x = y + 1 or test()
+    };
+
+    struct Statement {
+        StatementKind kind;
+        std::string name;          // Declared variable
+        std::string type;          // Declared type, empty when inferred
+        bool constant = false;
+        std::optional<Expr> value;
+    };
+
+    // Type name as written in the source, parsed without LLVM so codegen and --check share it
+    struct TypeName {
+        enum class Kind {
+            Void,
+            Integer,
+            Float
+        };
+
+        Kind kind = Kind::Integer;
+        unsigned bits = 0;        // Of one element for vectors
+        unsigned lanes = 0;       // 0 for scalars
+        bool nativeLanes = false; // <element>xN, the lane count follows the target
+    };
+
+    // Named source buffer for compiling without the filesystem
+    struct VirtualFile {
+        std::string name;      // Shown in diagnostics, e.g. "main.nl"
+        std::string contents;
+    };
+
+    struct CompileResult {
+        std::shared_ptr<llvm::LLVMContext> context; // Owns module's types, outlives a recycleContext of the compiler
+        std::unique_ptr<llvm::Module> module; // Null when an error was reported
+        std::string object;                   // Object file bytes, only when requested
+        std::vector<ParseError> diagnostics;
+
+        bool valid() const { return module != nullptr; }
+    };
+
     struct ParseResult {
         std::vector<std::string> actions;
         bool valid = true;
@@ -108,6 +229,7 @@ namespace Nova::Compiler {
         // Constructor/Destructor
         Compiler();
         explicit Compiler(std::string_view configPath);
+        explicit Compiler(const BuildOptions& options); // No nc.conf and no filesystem access, for compile()
         ~Compiler();
 
         // Prevent copying
@@ -121,6 +243,24 @@ namespace Nova::Compiler {
         std::string findConfig();
         void parseConfig(std::string_view configPath);
 
+        void setOptions(const BuildOptions& options);
+        const BuildOptions& options() const { return _options; }
+        const std::vector<Project>& projects() const { return _projects; }
+        void addProject(Project project) { _projects.push_back(std::move(project)); } // Without nc.conf, e.g. when embedded
+        llvm::LLVMContext& llvmContext();
+
+        // Memoized front end shared by builds, --check, watch mode and the language server
+        QueryEngine& queries();
+
+        // ========================================================================
+        // Public API - Memory
+        // ========================================================================
+
+        void reportMemoryUsage() const;
+        void recycleContext();
+        // Builds call this through beginGeneration, hosts that only run queries (the language server) once per edit
+        void checkMemory();
+
         // ========================================================================
         // Public API - Compilation
         // ========================================================================
@@ -128,16 +268,21 @@ namespace Nova::Compiler {
         void generateAll(std::string_view outputPath);
         void generateProject(const Project& project, std::string_view outputPath);
         std::vector<Assignment> codeParse(std::vector<Assignment> code);
-        void generateCode(std::string code);
+        CompileResult generateCode(std::string code);
+        CompileResult compile(const std::vector<VirtualFile>& files, bool emitObject = false);
         
         std::string compileToIR(std::string_view filePath, std::string_view outputPath, llvm::Module* module = nullptr);
 
+        // Lexing, parsing and semantic checks only, never creates LLVM objects. Returns the number of errors
+        size_t checkAll();
+
         // ========================================================================
         // Public API - Code Generation
         // ========================================================================
 
         void generateHeaders(std::string_view outputPath);
         void generateIR(llvm::Module* module, std::string_view sourcePath);
+        void generateIR(llvm::Module* module, const std::vector<std::string>& lines);
 
         // ========================================================================
         // Public API - Parsing (exposed for testing/debugging)
@@ -160,18 +305,48 @@ namespace Nova::Compiler {
         // ========================================================================
 
         std::vector<std::string> extractMultiLineBody(const std::vector<std::string>& lines, size_t startLine);
-        FunctionDeclaration parseFunctionDeclaration(const std::string& decl);
+        std::vector<std::string> functionBody(const std::vector<std::string>& lines, size_t funcLine, std::string& decl);
+        FunctionDeclaration parseFunctionDeclaration(const std::string& decl, bool diagnose = true);
+        void collectDeclarations(const std::vector<std::string>& lines);
+        std::vector<FunctionDeclaration> readDeclarations(const std::vector<std::string>& files);
+        std::optional<FunctionDeclaration> lookupDeclaration(const std::string& name) const;
+        void writeInterface(const Project& project, std::string_view outputPath);
+        llvm::Function* declareFunction(llvm::Module* module, const FunctionDeclaration& decl);
+
+        // ========================================================================
+        // Expression Parsing
+        // ========================================================================
+
+        bool parseStatement(const Assignment& assignment, Statement& statement, std::string& error);
+        std::optional<Expr> parseExpression(const std::vector<Token>& tokens, size_t& pos, int minPrecedence, std::string& error);
+        std::optional<Expr> parsePrimary(const std::vector<Token>& tokens, size_t& pos, std::string& error);
+        void foldConstants(Expr& expr);
         
         // ========================================================================
         // Type System
         // ========================================================================
 
+        // Nullopt for names that are not a type, error is set when a vector's lane count is malformed
+        static std::optional<TypeName> parseTypeName(const std::string& name, std::string& error);
         llvm::Type* novaTypeToLLVM(const std::string& novaType, llvm::LLVMContext& ctx);
+        unsigned nativeVectorBits();
+        llvm::Value* coerceValue(llvm::IRBuilder<>& builder, llvm::Value* value, llvm::Type* type);
+        llvm::Value* emitArithmetic(llvm::IRBuilder<>& builder, TokenType op, llvm::Value* lhs, llvm::Value* rhs);
         
         // ========================================================================
         // Code Generation
         // ========================================================================
 
+        void report(std::string_view severity, const std::string& funcName, size_t funcLine, const std::string& message);
+        void report(std::string_view severity, const std::string& message);
+        llvm::Value* emitExpression(
+            llvm::IRBuilder<>& builder,
+            const Expr& expr,
+            std::unordered_map<std::string, llvm::Value*>& locals,
+            const std::unordered_set<std::string>& constants,
+            std::string& error
+        );
+
         void generateFunctionBody(
             const std::vector<std::string>& code,
             llvm::Function* function,
@@ -180,6 +355,99 @@ namespace Nova::Compiler {
             size_t funcLine,
             llvm::LLVMContext& ctx
         );
+
+        void prepareModule(llvm::Module* module, std::string_view filePath);
+        void emitProject(const Project& project, const std::vector<llvm::Module*>& modules, const std::filesystem::path& outDir);
+        static std::vector<std::string> outputStems(const Project& project);
+        void writeIR(const std::filesystem::path& path, const llvm::Module& module);
+
+        // ========================================================================
+        // Target Selection
+        // ========================================================================
+
+        TargetSpec resolveTarget() const;
+        llvm::TargetMachine* targetMachine();
+        std::unique_ptr<llvm::TargetMachine> createTargetMachine() const;
+        void retarget(llvm::Module& module);
+        void emitForTargets(const Project& project, const std::vector<llvm::Module*>& modules, const std::filesystem::path& outDir);
+
+        // ========================================================================
+        // Machine Code
+        // ========================================================================
+
+        std::string emitObjectFile(llvm::Module& module);
+        size_t codegenThreads() const;
+        std::string objectFile(const std::filesystem::path& path, const llvm::Module& module);
+        void writeObject(const std::filesystem::path& path, std::string object);
+        std::vector<std::string> splitCodegen(llvm::Module& module, size_t partitions);
+        std::string combineObjects(std::vector<std::string> objects, std::string& error);
+        std::string link(const std::vector<std::string>& flags, const std::vector<ObjectBuffer>& inputs, std::string& error);
+
+        // ========================================================================
+        // Libraries
+        // ========================================================================
+
+        void emitLibrary(const Project& project, const std::vector<ObjectBuffer>& members, const std::filesystem::path& outDir);
+        void writeArchive(const std::filesystem::path& path, const std::vector<ObjectBuffer>& members);
+        void writeSharedLibrary(const std::filesystem::path& path, const std::vector<ObjectBuffer>& members);
+
+        // ========================================================================
+        // Memory
+        // ========================================================================
+
+        void beginGeneration();
+
+        // ========================================================================
+        // Linkage
+        // ========================================================================
+
+        std::unordered_set<std::string> exportedFunctions(const Project& project);
+        void inferLinkage(const Project& project, const std::vector<llvm::Module*>& modules);
+
+        // ========================================================================
+        // Tree Shaking
+        // ========================================================================
+
+        std::unordered_map<std::string, std::vector<std::string>> buildCallGraph(const std::vector<std::string>& files);
+        std::unordered_set<std::string> reachableFunctions(const Project& project);
+        bool isReachable(const std::string& funcLine);
+        void dropUnreachable(llvm::Module* module);
+
+        // ========================================================================
+        // Optimization / LTO
+        // ========================================================================
+
+        LTOMode resolveLTOMode(const Project& project) const;
+        bool usesProfile() const { return !_options.profileGenerate.empty() || !_options.profileUse.empty(); }
+        std::optional<llvm::PGOOptions> pgoOptions() const;
+        std::unique_ptr<llvm::Module> linkProject(const Project& project, std::vector<std::unique_ptr<llvm::Module>> modules);
+        void optimizeModule(llvm::Module& module, llvm::ThinOrFullLTOPhase phase = llvm::ThinOrFullLTOPhase::None);
+        std::string thinLTOBitcode(llvm::Module& module);
+        void optimizeFunctions(llvm::Module& module, const std::vector<std::string>& names);
+
+        // ========================================================================
+        // Syntax Check
+        // ========================================================================
+
+        std::vector<ParseError> checkSource(const std::string& file, const std::vector<std::string>& lines,
+                                            const std::unordered_map<std::string, size_t>& definitions);
+        void checkFunction(const std::string& file, const std::vector<std::string>& lines, size_t funcLine,
+                           const std::unordered_map<std::string, size_t>& definitions, std::vector<ParseError>& errors);
+        bool checkExpression(const Expr& expr, const std::unordered_set<std::string>& locals,
+                             const std::unordered_set<std::string>& constants, std::string& error) const;
+        static bool isKnownType(const std::string& type);
+
+        // ========================================================================
+        // Incremental Compilation
+        // ========================================================================
+
+        static uint64_t hashText(std::string_view text, uint64_t seed = 0xcbf29ce484222325ULL);
+        std::string optionsKey() const;
+        std::filesystem::path cachePath(const Project& project, std::string_view outputPath, const std::string& file) const;
+        ModuleCache& acquireModuleCache(const Project& project, std::string_view outputPath, const std::string& file);
+        void saveModuleCache(const Project& project, std::string_view outputPath, const std::string& file, const ModuleCache& cache);
+        void beginIncremental(llvm::Module* module, uint64_t salt);
+        void finishIncremental();
     public: // For now for testing
         std::vector<Assignment> splitCall(const std::string& line);
 
@@ -189,7 +457,35 @@ namespace Nova::Compiler {
         // ========================================================================
 
         std::vector<Project> _projects;
-        llvm::LLVMContext context;
+        BuildOptions _options;
+        TargetSpec _configTarget;
+        std::vector<TargetSpec> _configTargets; // targets list from nc.conf, the first one runs the frontend
+        std::shared_ptr<llvm::LLVMContext> context; // Created on first use, --check never needs one
+        std::unique_ptr<SourceDiscovery> _discovery; // Listings read by parseConfig, saved by the first build
+        size_t _generation = 0;        // Builds since the compiler was created
+        size_t _contextGeneration = 0; // Builds since the context was last recycled
+        size_t _configMemoryBudgetMB = 0;
+        std::unique_ptr<llvm::TargetMachine> _targetMachine;
+        unsigned _nativeVectorBits = 0;
+        std::unordered_set<std::string> _wideVectorWarnings; // Vector types already reported as wider than the target's registers
+
+        std::unordered_map<std::string, FunctionDeclaration> _declarations; // Every function of the project being built
+        uint64_t _declarationsSalt = 0;                                     // Hash over _declarations for the incremental cache
+        std::vector<InterfaceFile> _imports;                                // Mapped interfaces of the project's dependencies
+        std::unordered_set<std::string> _reachable;                         // Functions reachable from the project's roots
+        bool _treeShaking = false;                                          // Only _reachable functions are generated
+
+        std::unordered_map<std::string, ModuleCache> _moduleCache; // Source path -> cached module
+        ModuleCache* _activeCache = nullptr;                      // Cache of the file being generated
+
+        std::vector<ParseError>* _diagnostics = nullptr; // Collects reports instead of printing them during compile()
+        std::string _diagnosticFile;                     // Virtual file being compiled
+        const std::vector<std::string>* _sourceLines = nullptr;
+
+        ArtifactWriter _writer; // Output files are written off the compile thread
+        std::unique_ptr<QueryEngine> _queries; // Created on first use
+
+        friend class QueryEngine;
         
         NOVA_LOG_DEF("Compiler");
     };
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Nova::Compiler {
+
+    // Recursive source search with include/exclude globs, directories are walked on a thread pool.
+    // Every directory listing is remembered together with the directory's mtime, so the next run
+    // only has to stat directories that did not change instead of reading them again.
+    class SourceDiscovery {
+    public:
+        explicit SourceDiscovery(std::filesystem::path snapshotPath);
+
+        // Files below root whose path relative to root matches an include glob and no exclude glob.
+        // '*' also matches '/', so "*.nl" finds sources at any depth. Hidden directories are skipped.
+        std::vector<std::string> find(const std::filesystem::path& root,
+                                      const std::vector<std::string>& include,
+                                      const std::vector<std::string>& exclude = {});
+
+        // Stores the listings of this run, directories that were not visited are dropped
+        void save();
+
+        size_t listedDirectories() const { return _listed; }
+        size_t reusedDirectories() const { return _reused; }
+
+    private:
+        struct Listing {
+            int64_t mtime = 0; // 0 when the listing must not be trusted next run
+            std::vector<std::string> files;
+            std::vector<std::string> directories;
+        };
+
+        void load();
+        Listing list(const std::filesystem::path& directory);
+
+        std::filesystem::path _snapshotPath;
+        std::unordered_map<std::string, Listing> _snapshot; // Previous run, read only while walking
+        std::unordered_map<std::string, Listing> _current;  // This run
+        bool _changed = false;
+        int64_t _startTime = 0;
+
+        std::mutex _mutex;
+        size_t _listed = 0;
+        size_t _reused = 0;
+    };
+
+} // namespace Nova::Compiler
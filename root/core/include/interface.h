@@ -0,0 +1,68 @@
+#pragma once
+
+#include "compiler.h"
+#include <cstdint>
+#include <filesystem>
+#include <llvm/Support/MemoryBuffer.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Precompiled library interfaces (.nli): the public functions of a library in a
+// flat binary layout that is memory mapped on import instead of parsing sources
+namespace Nova::Compiler {
+
+    // ============================================================================
+    // On-disk Layout (header | symbols | args | string table)
+    // ============================================================================
+
+    struct InterfaceHeader {
+        char magic[4];          // "NVI" + format version
+        uint32_t symbolCount;
+        uint32_t argCount;
+        uint32_t stringsSize;
+        uint64_t hash;          // Hash over everything after the header
+    };
+
+    struct InterfaceSymbol {
+        uint64_t id;            // Stable symbol id, hash of the name
+        uint32_t name;          // Offset into the string table
+        uint32_t returnType;    // Offset into the string table
+        uint32_t firstArg;      // Index into the argument table
+        uint32_t argCount;
+    };
+
+    struct InterfaceArg {
+        uint32_t decl;          // Offset of the argument as written ("type name") into the string table
+    };
+
+    // ============================================================================
+    // Interface File
+    // ============================================================================
+
+    class InterfaceFile {
+    public:
+        // Serialized interface for the given functions, symbols are sorted by name
+        static std::string build(std::vector<FunctionDeclaration> functions);
+        static std::optional<InterfaceFile> open(const std::filesystem::path& path);
+
+        uint64_t hash() const { return header().hash; }
+        size_t size() const { return header().symbolCount; }
+
+        FunctionDeclaration declaration(size_t index) const;
+        std::optional<FunctionDeclaration> find(std::string_view name) const;
+
+    private:
+        explicit InterfaceFile(std::unique_ptr<llvm::MemoryBuffer> buffer) : _buffer(std::move(buffer)) {}
+
+        const InterfaceHeader& header() const;
+        const InterfaceSymbol* symbols() const;
+        const InterfaceArg* args() const;
+        const char* string(uint32_t offset) const;
+
+        std::unique_ptr<llvm::MemoryBuffer> _buffer;
+    };
+
+} // namespace Nova::Compiler
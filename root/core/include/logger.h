@@ -7,6 +7,9 @@
 // ==================== Logging Macros ====================
 static int logLinesPrinted = 0;
 
+// Everything but errors goes here, the language server points it at stderr since stdout carries the protocol
+inline std::ostream* logStream = &std::cout;
+
 inline int getPrintedLines() {
     return logLinesPrinted;
 }
@@ -17,27 +20,27 @@ inline void resetPrintedLines() {
 
 template<typename... Args>
 void NCINFO(fmt::format_string<Args...> fmt, Args&&... args) {
-    std::cout << termcolor::on_green << termcolor::bold
+    *logStream << termcolor::on_green << termcolor::bold
               << " INFO " << termcolor::reset << " "
               << fmt::format(fmt, std::forward<Args>(args)...) << "\n";
     logLinesPrinted++;
 }
 
 inline void _ncinfo() {
-    std::cout << termcolor::on_green << termcolor::bold << " INFO " << termcolor::reset << std::flush;
+    *logStream << termcolor::on_green << termcolor::bold << " INFO " << termcolor::reset << std::flush;
 }
 
 
 template<typename... Args>
 void NCWARN(fmt::format_string<Args...> fmt, Args&&... args) {
-    std::cout << termcolor::on_yellow << termcolor::bold
+    *logStream << termcolor::on_yellow << termcolor::bold
               << " WARN " << termcolor::reset << " "
               << fmt::format(fmt, std::forward<Args>(args)...) << "\n";
     logLinesPrinted++;
 }
 
 inline void _ncwarn() {
-    std::cout << termcolor::on_yellow << termcolor::bold << " WARN " << termcolor::reset << std::flush;
+    *logStream << termcolor::on_yellow << termcolor::bold << " WARN " << termcolor::reset << std::flush;
 }
 
 template<typename... Args>
@@ -49,5 +52,5 @@ void NCERROR(fmt::format_string<Args...> fmt, Args&&... args) {
 }
 
 inline void _nceror() {
-    std::cout << termcolor::on_red << termcolor::bold << " EROR " << termcolor::reset << std::flush;
+    *logStream << termcolor::on_red << termcolor::bold << " EROR " << termcolor::reset << std::flush;
 }
\ No newline at end of file
@@ -2,18 +2,33 @@
 
 #include "compiler.h"
 #include "logger.h"
+#include "query.h"
 #include <lsp/connection.h>
 #include <lsp/messagehandler.h>
 #include <lsp/messages.h>
 #include <lsp/io/standardio.h>
 #include <lsp/types.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
 
 
 namespace Nova::Compiler {
     class LSP {
         private:
+            // Open editor buffer and the diagnostics the client has for it
+            struct Document {
+                lsp::DocumentUri uri;
+                std::optional<std::vector<ParseError>> published;
+            };
+
             lsp::MessageHandler& handler;
             Nova::Compiler::Compiler compiler;
+            std::unordered_map<std::string, Document> documents;
 
 
         public:
@@ -32,7 +47,8 @@ namespace Nova::Compiler {
                                 .textDocumentSync = lsp::TextDocumentSyncOptions{
                                     .openClose = true,
                                     .change = lsp::TextDocumentSyncKind::Full
-                                }
+                                },
+                                .hoverProvider = true
                             },
                             .serverInfo = lsp::InitializeResultServerInfo{
                                 .name    = "Nova Language Server",
@@ -47,7 +63,129 @@ namespace Nova::Compiler {
                         NCINFO("Client has initialized.");
                     }
                 );
+
+                // Buffers go into the query engine, only what the edit actually changed is recomputed
+                handler.add<lsp::notifications::TextDocument_DidOpen>(
+                    [this](lsp::notifications::TextDocument_DidOpen::Params&& params) {
+                        const auto file = path(params.textDocument.uri);
+                        compiler.queries().setText(file, std::move(params.textDocument.text));
+                        documents.insert_or_assign(file, Document{params.textDocument.uri, std::nullopt});
+                        publishDiagnostics();
+                    }
+                );
+
+                handler.add<lsp::notifications::TextDocument_DidChange>(
+                    [this](lsp::notifications::TextDocument_DidChange::Params&& params) {
+                        if (params.contentChanges.empty()) return;
+
+                        // Full sync, the last change holds the whole document
+                        const auto file = path(params.textDocument.uri);
+                        auto text = std::visit([](auto& change) { return std::move(change.text); }, params.contentChanges.back());
+                        compiler.queries().setText(file, std::move(text));
+                        compiler.checkMemory(); // The server never builds, nothing else would recycle the context
+                        publishDiagnostics();
+                    }
+                );
+
+                handler.add<lsp::notifications::TextDocument_DidClose>(
+                    [this](lsp::notifications::TextDocument_DidClose::Params&& params) {
+                        // The file on disk takes over, files importing it may see other declarations now
+                        const auto file = path(params.textDocument.uri);
+                        compiler.queries().closeText(file);
+                        documents.erase(file);
+                        publishDiagnostics();
+                    }
+                );
+
+                handler.add<lsp::requests::TextDocument_Hover>(
+                    [this](lsp::requests::TextDocument_Hover::Params&& params) -> lsp::requests::TextDocument_Hover::Result {
+                        const auto file = path(params.textDocument.uri);
+                        const auto name = wordAt(file, params.position.line, params.position.character);
+                        if (name.empty()) return nullptr;
+
+                        const auto symbol = compiler.queries().lookup(file, name);
+                        if (!symbol) return nullptr;
+                        return lsp::Hover{
+                            .contents = lsp::MarkupContent{
+                                .kind = lsp::MarkupKind::Markdown,
+                                .value = hoverText(*symbol)
+                            }
+                        };
+                    }
+                );
             };
 
+            std::string path(const lsp::DocumentUri& uri) {
+                return compiler.queries().resolve(std::string(uri.path()));
+            }
+
+            // Every open document is checked against its project, an edit can change the diagnostics of
+            // other files through their imports. Only documents whose results changed are sent again
+            void publishDiagnostics() {
+                auto& queries = compiler.queries();
+                for (auto& [file, document] : documents) {
+                    const auto& errors = queries.diagnostics(file);
+                    if (document.published == errors) continue;
+                    document.published = errors;
+
+                    const auto& lines = queries.lines(file);
+                    std::vector<lsp::Diagnostic> diagnostics;
+                    for (const auto& error : errors) {
+                        // Errors are reported on the function's line, 1 based
+                        const unsigned line = error.line == 0 ? 0 : static_cast<unsigned>(error.line - 1);
+                        const unsigned length = line < lines.size() ? static_cast<unsigned>(lines[line].size()) : 0;
+                        diagnostics.push_back(lsp::Diagnostic{
+                            .range = lsp::Range{
+                                .start = lsp::Position{.line = line, .character = 0},
+                                .end = lsp::Position{.line = line, .character = length}
+                            },
+                            .severity = error.severity == "error" ? lsp::DiagnosticSeverity::Error : lsp::DiagnosticSeverity::Warning,
+                            .source = "nova",
+                            .message = error.message
+                        });
+                    }
+
+                    handler.sendNotification<lsp::notifications::TextDocument_PublishDiagnostics>(
+                        lsp::PublishDiagnosticsParams{
+                            .uri = document.uri,
+                            .diagnostics = std::move(diagnostics)
+                        }
+                    );
+                }
+            }
+
+            // Identifier under the cursor, positions are UTF-8 byte offsets
+            std::string wordAt(const std::string& file, unsigned lineNumber, unsigned character) {
+                const auto& lines = compiler.queries().lines(file);
+                if (lineNumber >= lines.size()) return "";
+
+                const auto& line = lines[lineNumber];
+                auto isWord = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+                size_t start = std::min<size_t>(character, line.size());
+                size_t end = start;
+                while (start > 0 && isWord(line[start - 1])) start--;
+                while (end < line.size() && isWord(line[end])) end++;
+                return line.substr(start, end - start);
+            }
+
+            static std::string hoverText(const QueryEngine::Symbol& symbol) {
+                const auto& decl = symbol.declaration;
+                std::string args;
+                for (const auto& arg : decl.args) args += (args.empty() ? "" : ", ") + arg;
+
+                std::string text = fmt::format("```nova\nfunc {}({}) -> {}\n```", decl.name, args, decl.returnType);
+                if (symbol.type) {
+                    std::string type;
+                    llvm::raw_string_ostream out(type);
+                    symbol.type->print(out);
+                    out.flush();
+                    text += fmt::format("\n\nLLVM: `{}`", type);
+                }else {
+                    text += "\n\nUnresolved types";
+                }
+                text += fmt::format("\n\n{}", std::filesystem::path(symbol.file).filename().string());
+                return text;
+            }
+
     };
 }
\ No newline at end of file
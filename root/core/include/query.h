@@ -0,0 +1,146 @@
+#pragma once
+
+#include "compiler.h"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Nova::Compiler {
+
+    // Demand driven, memoized front end: file text -> lines -> functions (tokens) -> declarations ->
+    // resolved types -> diagnostics. Every result remembers the queries it read and the revision it was
+    // last checked at. After an input changes only results whose dependencies actually produced a
+    // different value are computed again, so a body edit does not touch the declarations other files see.
+    // Owned by a Compiler and shared by the build, --check, the watch loop and the language server.
+    // Not thread safe.
+    class QueryEngine {
+    public:
+        struct FunctionSyntax {
+            size_t line = 0;                   // Line of "func", 0 based
+            std::string name;                  // Empty when the declaration is malformed
+            std::string decl;                  // Everything before the body
+            std::vector<Assignment> statements; // Tokenized body
+        };
+
+        struct Signature {
+            std::string name;
+            llvm::FunctionType* type = nullptr; // Null when a type name does not resolve
+        };
+
+        struct Symbol {
+            std::string file;
+            FunctionDeclaration declaration;
+            llvm::FunctionType* type = nullptr;
+        };
+
+        explicit QueryEngine(Compiler& compiler);
+
+        // ====================================================================
+        // Inputs, each change starts a new revision
+        // ====================================================================
+
+        // Editor buffer, replaces the file on disk until closed
+        void setText(const std::string& file, std::string text);
+        void closeText(const std::string& file);
+
+        // Re-stats every file read from disk, true when one of them has different contents
+        bool refresh();
+
+        // LLVM types from resolved signatures belong to a context that is going away
+        void invalidateTypes();
+
+        uint64_t revision() const { return _revision; }
+
+        // ====================================================================
+        // Queries
+        // ====================================================================
+
+        const std::string& text(const std::string& file);
+        const std::vector<std::string>& lines(const std::string& file);
+        const std::vector<FunctionSyntax>& functions(const std::string& file);
+        const std::vector<FunctionDeclaration>& declarations(const std::string& file);
+        const std::vector<Signature>& signatures(const std::string& file);
+        const std::vector<ParseError>& diagnostics(const std::string& file);
+
+        bool readable(const std::string& file);
+
+        // Function visible from file: its project first, then the packages it uses
+        std::optional<Symbol> lookup(const std::string& file, const std::string& name);
+
+        // Spelling of path used by the projects, paths from editors are absolute
+        std::string resolve(const std::string& path) const;
+
+    private:
+        enum class Kind : uint8_t {
+            Text,
+            Context,
+            Lines,
+            Functions,
+            Declarations,
+            Signatures,
+            Diagnostics
+        };
+
+        struct Key {
+            Kind kind;
+            std::string file;
+        };
+
+        template<typename T>
+        struct Memo {
+            T value;
+            uint64_t hash = 0;
+            uint64_t verifiedAt = 0; // Revision the value was last known to be current
+            uint64_t changedAt = 0;  // Revision the value last became different
+            std::vector<Key> deps;
+        };
+
+        template<typename T>
+        using Table = std::unordered_map<std::string, Memo<T>>;
+
+        struct Input {
+            std::string text;
+            uint64_t hash = 0;
+            uint64_t changedAt = 0;
+            bool open = false;     // Owned by the editor, disk is not looked at
+            bool readable = false;
+            std::filesystem::file_time_type mtime{};
+            uintmax_t size = 0;
+        };
+
+        template<typename T, typename Compute>
+        const T& fetch(Table<T>& table, Kind kind, const std::string& file, Compute compute);
+        bool upToDate(const std::vector<Key>& deps, uint64_t verifiedAt);
+        uint64_t changedAt(const Key& key);
+        void depend(Kind kind, const std::string& file);
+
+        Input& input(const std::string& file);
+        bool load(Input& input, const std::string& file);
+
+        // Result hashes, an unchanged hash lets dependents keep their values
+        static uint64_t fingerprint(const std::vector<std::string>& lines);
+        static uint64_t fingerprint(const std::vector<FunctionSyntax>& functions);
+        static uint64_t fingerprint(const std::vector<FunctionDeclaration>& declarations);
+        static uint64_t fingerprint(const std::vector<Signature>& signatures);
+        static uint64_t fingerprint(const std::vector<ParseError>& errors);
+
+        // Files whose declarations are visible from file, split into its own project and its packages
+        std::pair<std::vector<std::string>, std::vector<std::string>> scope(const std::string& file) const;
+
+        Compiler& _compiler;
+        uint64_t _revision = 1;
+        uint64_t _contextChangedAt = 1;
+        std::vector<std::vector<Key>*> _active; // Dependencies of the queries being computed, null while verifying
+
+        std::unordered_map<std::string, Input> _inputs;
+        Table<std::vector<std::string>> _lines;
+        Table<std::vector<FunctionSyntax>> _functions;
+        Table<std::vector<FunctionDeclaration>> _declarations;
+        Table<std::vector<Signature>> _signatures;
+        Table<std::vector<ParseError>> _diagnostics;
+    };
+
+} // namespace Nova::Compiler
@@ -0,0 +1,261 @@
+#include "artifact_writer.h"
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <fstream>
+#include <system_error>
+#include <utility>
+#include <unistd.h>
+#ifdef NOVA_HAS_IO_URING
+#include <liburing.h>
+#endif
+
+namespace Nova::Compiler {
+
+// Writes submitted to the ring at once, larger batches are split
+static constexpr unsigned RING_ENTRIES = 64;
+static constexpr size_t MAX_POOL_THREADS = 4;
+
+ArtifactWriter::ArtifactWriter() {
+#ifdef NOVA_HAS_IO_URING
+    auto* ring = new io_uring;
+    if (io_uring_queue_init(RING_ENTRIES, ring, 0) == 0) {
+        _ring = ring;
+    }else {
+        // Old kernel or io_uring disabled by policy, use the thread pool
+        delete ring;
+    }
+#endif
+
+    size_t threads = 1;
+    if (_ring == nullptr) {
+        threads = std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, MAX_POOL_THREADS);
+    }
+    for (size_t i = 0; i < threads; i++) {
+        _threads.emplace_back([this]() { run(); });
+    }
+}
+
+ArtifactWriter::~ArtifactWriter() {
+    {
+        std::lock_guard lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (auto& thread : _threads) thread.join();
+
+#ifdef NOVA_HAS_IO_URING
+    if (_ring) {
+        auto* ring = static_cast<io_uring*>(_ring);
+        io_uring_queue_exit(ring);
+        delete ring;
+    }
+#endif
+}
+
+void ArtifactWriter::submit(std::filesystem::path path, std::string contents) {
+    {
+        std::lock_guard lock(_mutex);
+        _queue.push_back(Artifact{std::move(path), std::move(contents)});
+        _pending++;
+    }
+    _wake.notify_one();
+}
+
+void ArtifactWriter::flush() {
+    std::unique_lock lock(_mutex);
+    _idle.wait(lock, [this]() { return _pending == 0; });
+}
+
+ArtifactWriter::Stats ArtifactWriter::takeStats() {
+    std::lock_guard lock(_mutex);
+    return std::exchange(_stats, Stats{});
+}
+
+// With io_uring one thread drains the whole queue per batch, pool threads take one artifact each
+void ArtifactWriter::run() {
+    while (true) {
+        std::vector<Artifact> batch;
+        {
+            std::unique_lock lock(_mutex);
+            _wake.wait(lock, [this]() { return _stop || !_queue.empty(); });
+            if (_queue.empty()) return;
+
+            const size_t take = _ring ? _queue.size() : 1;
+            for (size_t i = 0; i < take; i++) {
+                batch.push_back(std::move(_queue.front()));
+                _queue.pop_front();
+            }
+        }
+        writeBatch(batch);
+    }
+}
+
+void ArtifactWriter::writeBatch(std::vector<Artifact>& batch) {
+    std::vector<Artifact*> jobs;
+    for (auto& artifact : batch) {
+        if (unchanged(artifact)) {
+            std::lock_guard lock(_mutex);
+            _stats.unchanged++;
+            if (--_pending == 0) _idle.notify_all();
+            continue;
+        }
+        jobs.push_back(&artifact);
+    }
+
+    size_t start = 0;
+    for (; _ring && start < jobs.size(); start += RING_ENTRIES) {
+        std::vector<Artifact*> chunk(jobs.begin() + start, jobs.begin() + std::min(jobs.size(), start + RING_ENTRIES));
+        writeBatchIoUring(chunk);
+    }
+
+    // No ring, or it was torn down by a failed chunk
+    for (size_t i = start; i < jobs.size(); i++) {
+        finish(*jobs[i], writeFile(*jobs[i]));
+    }
+}
+
+#ifdef NOVA_HAS_IO_URING
+// All writes of the chunk are queued with one submit, short writes are resubmitted for the rest
+void ArtifactWriter::writeBatchIoUring(std::vector<Artifact*>& jobs) {
+    struct Job {
+        Artifact* artifact;
+        std::filesystem::path temp;
+        int fd = -1;
+        size_t offset = 0;
+        bool ok = true;
+        bool inflight = false; // The kernel may still read from the buffer
+    };
+
+    auto* ring = static_cast<io_uring*>(_ring);
+    std::vector<Job> work;
+    work.reserve(jobs.size());
+
+    auto queueWrite = [ring](Job& job) {
+        io_uring_sqe* sqe = io_uring_get_sqe(ring);
+        const auto& contents = job.artifact->contents;
+        io_uring_prep_write(sqe, job.fd, contents.data() + job.offset, contents.size() - job.offset, job.offset);
+        io_uring_sqe_set_data(sqe, &job);
+        job.inflight = true;
+    };
+
+    for (auto* artifact : jobs) {
+        Job job{artifact, temporaryPath(artifact->path)};
+        job.fd = ::open(job.temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (job.fd < 0) job.ok = false;
+        work.push_back(std::move(job));
+    }
+
+    size_t inflight = 0;
+    for (auto& job : work) {
+        if (job.fd < 0 || job.artifact->contents.empty()) continue;
+        queueWrite(job);
+        inflight++;
+    }
+    io_uring_submit(ring);
+
+    while (inflight > 0) {
+        io_uring_cqe* cqe = nullptr;
+        const int status = io_uring_wait_cqe(ring, &cqe);
+        if (status == -EINTR) continue;
+        if (status < 0) {
+            // Writes can still be running, the ring goes away before their buffers and fds do.
+            // Everything after this batch uses the thread pool path
+            NCERROR("io_uring wait failed ({}), falling back to blocking writes", -status);
+            io_uring_queue_exit(ring);
+            delete ring;
+            _ring = nullptr;
+            break;
+        }
+
+        auto& job = *static_cast<Job*>(io_uring_cqe_get_data(cqe));
+        const int result = cqe->res;
+        io_uring_cqe_seen(ring, cqe);
+        job.inflight = false;
+        inflight--;
+
+        if (result < 0) {
+            job.ok = false;
+            continue;
+        }
+        job.offset += static_cast<size_t>(result);
+        if (job.offset < job.artifact->contents.size() && result > 0) {
+            queueWrite(job);
+            io_uring_submit(ring);
+            inflight++;
+        }else if (job.offset < job.artifact->contents.size()) {
+            job.ok = false;
+        }
+    }
+
+    for (auto& job : work) {
+        if (job.fd >= 0) ::close(job.fd);
+
+        // Only a temp file holding every byte may replace the artifact
+        if (job.inflight || job.offset != job.artifact->contents.size()) job.ok = false;
+        std::error_code ec;
+        if (job.ok) std::filesystem::rename(job.temp, job.artifact->path, ec);
+        if (!job.ok || ec) std::filesystem::remove(job.temp, ec);
+        finish(*job.artifact, job.ok && !ec);
+    }
+}
+#else
+void ArtifactWriter::writeBatchIoUring(std::vector<Artifact*>& jobs) {
+    for (auto* artifact : jobs) finish(*artifact, writeFile(*artifact));
+}
+#endif
+
+// Temporary file next to the target, renamed over it so readers never see half a file
+bool ArtifactWriter::writeFile(const Artifact& artifact) {
+    const auto temp = temporaryPath(artifact.path);
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        file.write(artifact.contents.data(), static_cast<std::streamsize>(artifact.contents.size()));
+        if (!file.good()) {
+            file.close();
+            std::error_code ec;
+            std::filesystem::remove(temp, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp, artifact.path, ec);
+    if (ec) std::filesystem::remove(temp, ec);
+    return !ec;
+}
+
+void ArtifactWriter::finish(const Artifact& artifact, bool ok) {
+    std::lock_guard lock(_mutex);
+    if (ok) {
+        _stats.written++;
+    }else {
+        _stats.failed++;
+        NCERROR("Failed to write {}", artifact.path.string());
+    }
+    if (--_pending == 0) _idle.notify_all();
+}
+
+// Same size and same bytes, rewriting would only touch the timestamp
+bool ArtifactWriter::unchanged(const Artifact& artifact) {
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(artifact.path, ec);
+    if (ec || size != artifact.contents.size()) return false;
+
+    std::ifstream file(artifact.path, std::ios::binary);
+    std::string existing(size, '\0');
+    if (!file.read(existing.data(), static_cast<std::streamsize>(size))) return false;
+    return existing == artifact.contents;
+}
+
+std::filesystem::path ArtifactWriter::temporaryPath(const std::filesystem::path& path) {
+    static std::atomic<unsigned> counter{0};
+    auto temp = path;
+    temp += ".tmp." + std::to_string(::getpid()) + "." + std::to_string(counter++);
+    return temp;
+}
+
+} // namespace Nova::Compiler
@@ -0,0 +1,250 @@
+#include "compiler.h"
+#include "interface.h"
+#include "logger.h"
+#include "query.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace Nova::Compiler {
+
+// Same parser novaTypeToLLVM uses, without building the LLVM type
+bool Compiler::isKnownType(const std::string& type) {
+    std::string error;
+    return parseTypeName(type, error).has_value();
+}
+
+static void printDiagnostic(const ParseError& error) {
+    if (error.severity == "error") _nceror(); else _ncwarn();
+    *logStream << termcolor::grey << termcolor::bold
+              << fmt::format("      [{}:{}] ", std::filesystem::path(error.file).filename().string(), error.line)
+              << termcolor::reset
+              << error.message
+              << std::endl;
+}
+
+// Every project is checked against its own declarations and the sources of its packages,
+// files are independent of each other so they are checked in parallel
+size_t Compiler::checkAll() {
+    size_t errors = 0, warnings = 0, files = 0;
+
+    for (const auto& project : _projects) {
+        _declarations.clear();
+        _imports.clear();
+
+        std::unordered_map<std::string, size_t> definitions;
+        for (auto& decl : readDeclarations(project.files)) {
+            definitions[decl.name]++;
+            _declarations[decl.name] = std::move(decl);
+        }
+        // No interface files are needed, the dependency's declarations are read from its sources
+        for (const auto& dependency : project.dependencies) {
+            auto it = std::find_if(_projects.begin(), _projects.end(), [&](const Project& p) { return p.name == dependency; });
+            if (it == _projects.end()) {
+                printDiagnostic(ParseError{0, 0, fmt::format("Unknown package '{}'", dependency), "error", project.name, ""});
+                errors++;
+                continue;
+            }
+            for (auto& decl : readDeclarations(it->headers.empty() ? it->files : it->headers)) {
+                _declarations.try_emplace(decl.name, std::move(decl));
+            }
+        }
+
+        // The query engine is single threaded, sources are read (or reused) before the pool starts
+        std::vector<const std::vector<std::string>*> sources;
+        for (const auto& file : project.files) {
+            sources.push_back(queries().readable(file) ? &queries().lines(file) : nullptr);
+        }
+
+        std::vector<std::vector<ParseError>> results(project.files.size());
+        std::atomic<size_t> next{0};
+        auto worker = [&]() {
+            for (size_t i = next++; i < project.files.size(); i = next++) {
+                if (sources[i] == nullptr) {
+                    results[i].push_back(ParseError{0, 0, "Failed to open source file", "error", project.files[i], ""});
+                    continue;
+                }
+                results[i] = checkSource(project.files[i], *sources[i], definitions);
+            }
+        };
+
+        const size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), project.files.size());
+        std::vector<std::thread> pool;
+        for (size_t i = 1; i < threads; i++) pool.emplace_back(worker);
+        worker();
+        for (auto& thread : pool) thread.join();
+
+        // Printed in file order so the output does not depend on scheduling
+        for (const auto& fileErrors : results) {
+            for (const auto& error : fileErrors) {
+                printDiagnostic(error);
+                if (error.severity == "error") errors++; else warnings++;
+            }
+        }
+        files += project.files.size();
+    }
+
+    NCINFO("Checked {} files: {} errors, {} warnings", files, errors, warnings);
+    return errors;
+}
+
+std::vector<ParseError> Compiler::checkSource(const std::string& file, const std::vector<std::string>& lines,
+                                              const std::unordered_map<std::string, size_t>& definitions) {
+    std::vector<ParseError> errors;
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (lines[i].find("func ") != std::string::npos) checkFunction(file, lines, i, definitions, errors);
+    }
+    return errors;
+}
+
+// Mirrors the checks of generateFunctionBody, only the ones that need LLVM types are left out
+void Compiler::checkFunction(const std::string& file, const std::vector<std::string>& lines, size_t funcLine,
+                             const std::unordered_map<std::string, size_t>& definitions, std::vector<ParseError>& errors) {
+    auto error = [&](std::string_view severity, std::string message) {
+        errors.push_back(ParseError{funcLine + 1, 0, std::move(message), std::string(severity), file, lines[funcLine]});
+    };
+
+    std::string decl;
+    const auto code = functionBody(lines, funcLine, decl);
+    const auto declaration = parseFunctionDeclaration(decl, false);
+    if (!declaration.valid) {
+        error("error", "Invalid function declaration");
+        return;
+    }
+    if (const auto it = definitions.find(declaration.name); it != definitions.end() && it->second > 1) {
+        error("error", fmt::format("'{}' is defined more than once", declaration.name));
+    }
+    if (!isKnownType(declaration.returnType)) {
+        error("error", fmt::format("Unknown return type: {}", declaration.returnType));
+        return;
+    }
+
+    std::unordered_set<std::string> locals, constants;
+    for (const auto& arg : declaration.args) {
+        const auto parts = tokenize(arg);
+        const std::string typeName = parts.size() > 1 ? parts[0] : "int";
+        if (!isKnownType(typeName) || typeName == "void") {
+            error("error", fmt::format("Unknown argument type: {}", typeName));
+            return;
+        }
+        locals.insert(parts.back());
+    }
+
+    std::vector<Assignment> assignments;
+    for (const auto& line : code) {
+        auto lineAssignments = splitCall(line);
+        assignments.insert(assignments.end(), lineAssignments.begin(), lineAssignments.end());
+    }
+
+    const bool returnsVoid = declaration.returnType == "void";
+    bool hasReturn = false;
+    for (const auto& assignment : assignments) {
+        if (assignment.tokens.empty() ||
+            assignment.tokens[0].type == TokenType::LBrace || assignment.tokens[0].type == TokenType::RBrace) {
+            continue;
+        }
+        if (hasReturn) {
+            error("warning", "Code after 'ret' is never executed");
+            break;
+        }
+
+        Statement statement;
+        std::string message;
+        if (!parseStatement(assignment, statement, message)) {
+            error("error", message);
+            break;
+        }
+
+        if (statement.kind == StatementKind::Return) {
+            hasReturn = true;
+            if (!statement.value && !returnsVoid) {
+                error("error", "'ret' without a value in a function returning a value");
+                break;
+            }
+            if (statement.value && returnsVoid) {
+                error("error", "Return value does not match the return type");
+                break;
+            }
+            if (statement.value && !checkExpression(*statement.value, locals, constants, message)) {
+                error("error", message);
+                break;
+            }
+            continue;
+        }
+
+        if (statement.kind == StatementKind::Declare) {
+            if (locals.contains(statement.name)) {
+                error("error", fmt::format("'{}' is already declared", statement.name));
+                break;
+            }
+            if (!statement.type.empty() && (!isKnownType(statement.type) || statement.type == "void")) {
+                error("error", fmt::format("Unknown type '{}'", statement.type));
+                break;
+            }
+            if (!checkExpression(*statement.value, locals, constants, message)) {
+                error("error", message);
+                break;
+            }
+            locals.insert(statement.name);
+            if (statement.constant) constants.insert(statement.name);
+            continue;
+        }
+
+        if (!checkExpression(*statement.value, locals, constants, message)) {
+            error("error", message);
+            break;
+        }
+    }
+
+    if (!hasReturn) error("warning", "Function has no return statement");
+}
+
+// Names and call arities, operand types are only known once LLVM types exist
+bool Compiler::checkExpression(const Expr& expr, const std::unordered_set<std::string>& locals,
+                               const std::unordered_set<std::string>& constants, std::string& error) const {
+    switch (expr.kind) {
+        case ExprKind::Number:
+            return true;
+
+        case ExprKind::Variable:
+            if (!locals.contains(expr.value)) {
+                error = fmt::format("Unknown variable '{}'", expr.value);
+                return false;
+            }
+            return true;
+
+        case ExprKind::Assign:
+            if (!locals.contains(expr.value)) {
+                error = fmt::format("Assignment to undeclared variable '{}'", expr.value);
+                return false;
+            }
+            if (constants.contains(expr.value)) {
+                error = fmt::format("Can not assign to constant '{}'", expr.value);
+                return false;
+            }
+            return checkExpression(expr.operands[0], locals, constants, error);
+
+        case ExprKind::Call: {
+            const auto decl = lookupDeclaration(expr.value);
+            if (!decl) {
+                error = fmt::format("Unknown function '{}'", expr.value);
+                return false;
+            }
+            if (decl->args.size() != expr.operands.size()) {
+                error = fmt::format("{} expects {} arguments, got {}", expr.value, decl->args.size(), expr.operands.size());
+                return false;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    for (const auto& operand : expr.operands) {
+        if (!checkExpression(operand, locals, constants, error)) return false;
+    }
+    return true;
+}
+
+} // namespace Nova::Compiler
@@ -0,0 +1,187 @@
+#include "compiler.h"
+#include "logger.h"
+#include <fstream>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#include <thread>
+
+namespace Nova::Compiler {
+
+// Below this many functions per partition the threads cost more than they save
+static constexpr size_t MIN_FUNCTIONS_PER_PARTITION = 32;
+
+// Object file bytes for the module, the codegen pipeline still needs the legacy pass manager
+static std::string emitObject(llvm::TargetMachine& machine, llvm::Module& module, std::string& error) {
+    llvm::SmallVector<char, 0> buffer;
+    llvm::raw_svector_ostream out(buffer);
+    llvm::legacy::PassManager passes;
+    if (machine.addPassesToEmitFile(passes, out, nullptr, llvm::CodeGenFileType::ObjectFile)) {
+        error = fmt::format("Target {} can not emit object files", machine.getTargetTriple().str());
+        return {};
+    }
+    passes.run(module);
+    return std::string(buffer.begin(), buffer.end());
+}
+
+std::string Compiler::emitObjectFile(llvm::Module& module) {
+    auto* machine = targetMachine();
+    if (!machine) return {};
+
+    std::string error;
+    auto object = emitObject(*machine, module, error);
+    if (!error.empty()) report("error", error);
+    return object;
+}
+
+size_t Compiler::codegenThreads() const {
+    if (_options.codegenThreads != 0) return _options.codegenThreads;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Codegen rewrites the module, it always works on a copy so cached modules stay untouched.
+// Empty when codegen failed
+std::string Compiler::objectFile(const std::filesystem::path& path, const llvm::Module& module) {
+    auto copy = llvm::CloneModule(module);
+
+    size_t definitions = 0;
+    for (const auto& function : *copy) {
+        if (!function.isDeclaration()) definitions++;
+    }
+    const size_t partitions = std::min(codegenThreads(), definitions / MIN_FUNCTIONS_PER_PARTITION);
+
+    if (partitions < 2) return emitObjectFile(*copy);
+
+    auto objects = splitCodegen(*copy, partitions);
+    if (objects.empty()) return {};
+    NCINFO("  {}: {} functions generated in {} partitions", path.filename().string(), definitions, objects.size());
+
+    std::string error;
+    auto combined = combineObjects(std::move(objects), error);
+    if (!combined.empty()) return combined;
+
+    NWARN("  Combining partitions failed: {}, generating {} on one thread", error, path.filename().string());
+    return emitObjectFile(*copy);
+}
+
+// Empty objects come from failed codegen
+void Compiler::writeObject(const std::filesystem::path& path, std::string object) {
+    if (!object.empty()) {
+        _writer.submit(path, std::move(object));
+        return;
+    }
+    // An object of an earlier build would be linked as if it was current
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
+
+// Partitions come out of SplitModule in the module's context, they leave it as bitcode so
+// every thread can load its own into a private context and run it through a private machine.
+// Internal functions stay internal: SplitModule keeps them in the partition of their users instead
+// of externalizing them, which ld -r would otherwise turn into global symbols of the combined object
+std::vector<std::string> Compiler::splitCodegen(llvm::Module& module, size_t partitions) {
+    std::vector<std::string> bitcode;
+    llvm::SplitModule(module, static_cast<unsigned>(partitions), [&](std::unique_ptr<llvm::Module> part) {
+        std::string buffer;
+        llvm::raw_string_ostream out(buffer);
+        llvm::WriteBitcodeToFile(*part, out);
+        out.flush();
+        bitcode.push_back(std::move(buffer));
+    }, /*PreserveLocals=*/true);
+
+    std::vector<std::string> objects(bitcode.size());
+    std::vector<std::string> errors(bitcode.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < bitcode.size(); i++) {
+        auto machine = createTargetMachine();
+        if (!machine) break;
+
+        threads.emplace_back([&bitcode, &objects, &errors, i, machine = std::move(machine)]() {
+            llvm::LLVMContext context;
+            auto part = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode[i], "partition"), context);
+            if (!part) {
+                errors[i] = llvm::toString(part.takeError());
+                return;
+            }
+            objects[i] = emitObject(*machine, **part, errors[i]);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    if (threads.size() != bitcode.size()) return {};
+    for (const auto& error : errors) {
+        if (error.empty()) continue;
+        NERROR("  Partition codegen failed: {}", error);
+        return {};
+    }
+    return objects;
+}
+
+// Runs ld.lld (or ld) over in-memory inputs and returns what it produced
+std::string Compiler::link(const std::vector<std::string>& flags, const std::vector<ObjectBuffer>& inputs, std::string& error) {
+    auto linker = llvm::sys::findProgramByName("ld.lld");
+    if (!linker) linker = llvm::sys::findProgramByName("ld");
+    if (!linker) {
+        error = "no linker found";
+        return {};
+    }
+
+    llvm::SmallString<128> tempDir;
+    if (llvm::sys::fs::createUniqueDirectory("nova-link", tempDir)) {
+        error = "can not create a temporary directory";
+        return {};
+    }
+
+    const std::filesystem::path dir(tempDir.str().str());
+    const auto output = (dir / "output").string();
+    std::vector<std::string> args{*linker};
+    args.insert(args.end(), flags.begin(), flags.end());
+    args.push_back("-o");
+    args.push_back(output);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        // Numbered, two members of a library may share a file name
+        const auto inputPath = dir / fmt::format("{}-{}", i, inputs[i].name);
+        std::ofstream input(inputPath, std::ios::binary);
+        input.write(inputs[i].bytes.data(), static_cast<std::streamsize>(inputs[i].bytes.size()));
+        input.close();
+        if (!input) {
+            error = fmt::format("can not write {}", inputPath.string());
+            std::error_code ec;
+            std::filesystem::remove_all(dir, ec);
+            return {};
+        }
+        args.push_back(inputPath.string());
+    }
+
+    std::vector<llvm::StringRef> argRefs(args.begin(), args.end());
+    const int status = llvm::sys::ExecuteAndWait(*linker, argRefs, std::nullopt, {}, 0, 0, &error);
+
+    std::ifstream file(output, std::ios::binary);
+    std::string result((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+
+    if (status != 0 || result.empty()) {
+        error = fmt::format("{} failed{}", *linker, error.empty() ? "" : fmt::format(" ({})", error));
+        return {};
+    }
+    return result;
+}
+
+// One relocatable object via "ld -r"
+std::string Compiler::combineObjects(std::vector<std::string> objects, std::string& error) {
+    std::vector<ObjectBuffer> parts;
+    for (size_t i = 0; i < objects.size(); i++) {
+        parts.push_back(ObjectBuffer{fmt::format("part{}.o", i), std::move(objects[i])});
+    }
+    return link({"-r"}, parts, error);
+}
+
+} // namespace Nova::Compiler
@@ -1,15 +1,19 @@
 #include "compiler.h"
 #include "core.h"
+#include "discovery.h"
+#include "interface.h"
 #include "logger.h"
+#include "query.h"
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <cstring>
+#include <functional>
 #include <filesystem>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
-#include <llvm/TargetParser/Triple.h>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -23,10 +27,14 @@
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Utils/Cloning.h>
 
 
 namespace Nova::Compiler {
 
+    // Monorepos have far too many sources to print each one
+    static constexpr size_t MAX_LISTED_FILES = 32;
+
     Compiler::~Compiler() {
 
     };
@@ -36,6 +44,27 @@ namespace Nova::Compiler {
         NCINFO("Custom config file loading not yet supported");
     }
 
+    Compiler::Compiler(const BuildOptions& options) : _options(options) {}
+
+    void Compiler::setOptions(const BuildOptions& options) {
+        _options = options;
+        _targetMachine.reset();
+        _nativeVectorBits = 0;
+        _wideVectorWarnings.clear();
+        // xN vector types depend on the target
+        if (_queries) _queries->invalidateTypes();
+    }
+
+    llvm::LLVMContext& Compiler::llvmContext() {
+        if (!context) context = std::make_shared<llvm::LLVMContext>();
+        return *context;
+    }
+
+    QueryEngine& Compiler::queries() {
+        if (!_queries) _queries = std::make_unique<QueryEngine>(*this);
+        return *_queries;
+    }
+
     Compiler::Compiler() {
         const auto configPath = findConfig();
         if (configPath.empty()) {
@@ -75,6 +104,33 @@ namespace Nova::Compiler {
 
         NCINFO("Project root: {}", absoluteProjectDir.string());
 
+        if (const auto* os = config.find("targetOS"); os && os->is_string()) _configTarget.os = os->get_string();
+        if (const auto* target = config.find("target"); target && target->is_string()) _configTarget.triple = target->get_string();
+        if (const auto* cpu = config.find("cpu"); cpu && cpu->is_string()) _configTarget.cpu = cpu->get_string();
+        if (const auto* features = config.find("features"); features && features->is_string()) _configTarget.features = features->get_string();
+        if (const auto* budget = config.find("memoryBudget"); budget && budget->is_integer()) _configMemoryBudgetMB = budget->as<std::size_t>();
+
+        // targets = ["x86_64-unknown-linux-gnu", { triple = "aarch64-unknown-linux-gnu" cpu = "cortex-a72" }]
+        if (const auto* targets = config.find("targets"); targets && targets->is_array()) {
+            for (const auto& entry : targets->get_array()) {
+                TargetSpec spec = _configTarget;
+                if (entry.is_string()) {
+                    spec.triple = entry.get_string();
+                }else if (entry.is_object()) {
+                    if (const auto* triple = entry.find("triple"); triple && triple->is_string()) spec.triple = triple->get_string();
+                    if (const auto* cpu = entry.find("cpu"); cpu && cpu->is_string()) spec.cpu = cpu->get_string();
+                    if (const auto* features = entry.find("features"); features && features->is_string()) spec.features = features->get_string();
+                }
+                NCINFO("Target: {}", spec.triple);
+                _configTargets.push_back(spec);
+            }
+            if (!_configTargets.empty()) _configTarget = _configTargets.front();
+        }
+
+        // Directory listings of the last run, unchanged directories are not read again
+        _discovery = std::make_unique<SourceDiscovery>(absoluteProjectDir / ".nova-cache" / "sources.snapshot");
+        auto& discovery = *_discovery;
+
         for (const auto& [projectName, projectConfig] : projects.get_object()) {
             Project project;
 
@@ -101,6 +157,29 @@ namespace Nova::Compiler {
                 }
             }
 
+            if (const auto* lto = projectConfig.find("lto"); lto && lto->is_string()) {
+                const auto ltoStr = lto->get_string();
+                if (ltoStr == "full") {
+                    project.lto = LTOMode::Full;
+                }else if (ltoStr == "thin") {
+                    project.lto = LTOMode::Thin;
+                }else if (ltoStr == "auto") {
+                    project.lto = LTOMode::Auto;
+                }else if (ltoStr == "none") {
+                    project.lto = LTOMode::None;
+                }else {
+                    NWARN("  ├▶ Unknown lto mode '{}' - LTO disabled", ltoStr);
+                }
+                if (project.lto) NCINFO("  ├▶ LTO: {}", ltoStr);
+            }
+
+            if (const auto* packages = projectConfig.find("packages"); packages && packages->is_array()) {
+                for (const auto& package : packages->get_array()) {
+                    project.dependencies.push_back(package.get_string());
+                    NCINFO("  ├▶ Depends on: {}", package.get_string());
+                }
+            }
+
             const auto sourceDir = absoluteProjectDir / projectConfig.at("sourceDir").get_string();
             
             if (!std::filesystem::exists(sourceDir)) {
@@ -109,6 +188,7 @@ namespace Nova::Compiler {
             }
 
             NCINFO("  ├▶ Source directory: {}", sourceDir.string());
+            project.sourceDir = sourceDir;
 
             std::string sourceFileExt = ".nl";
             if (projectConfig.at("sourceFiles").is_string()) {
@@ -117,26 +197,46 @@ namespace Nova::Compiler {
                 NCINFO("  ├▶ Extension filter: .nl (default)");
             }
 
-            NCINFO("  └─┐Source Files:");
-            int size = 0;
-            for (const auto& file : std::filesystem::directory_iterator(sourceDir)) {
-                if (file.path().extension() == sourceFileExt) {
-                    project.files.push_back(file.path().string());
-                    if (size + 1 == project.files.size()) {
-                        NCINFO("    └─➤ {}", file.path().filename().string());
-                    }else {
-                        NCINFO("    ├─➤ {}", file.path().filename().string());
-                    };
-                    size++;
+            // Globs are relative to sourceDir, by default every file with the source extension at any depth
+            std::vector<std::string> includeGlobs{"*" + sourceFileExt}, excludeGlobs;
+            if (const auto* globs = projectConfig.find("includeGlobs"); globs && globs->is_array()) {
+                includeGlobs.clear();
+                for (const auto& glob : globs->get_array()) includeGlobs.push_back(glob.get_string());
+            }
+            if (const auto* globs = projectConfig.find("excludeGlobs"); globs && globs->is_array()) {
+                for (const auto& glob : globs->get_array()) excludeGlobs.push_back(glob.get_string());
+            }
+
+            project.files = discovery.find(sourceDir, includeGlobs, excludeGlobs);
+
+            NCINFO("  └─┐Source Files: {}", project.files.size());
+            const size_t shown = std::min(project.files.size(), MAX_LISTED_FILES);
+            for (size_t i = 0; i < shown; i++) {
+                const auto name = std::filesystem::relative(project.files[i], sourceDir).string();
+                if (i + 1 == project.files.size()) {
+                    NCINFO("    └─➤ {}", name);
+                }else {
+                    NCINFO("    ├─➤ {}", name);
                 }
-                
             }
+            if (shown < project.files.size()) NCINFO("    └─➤ ... {} more", project.files.size() - shown);
 
             NCINFO("  ┌▶ Header Files:");
-            //for (const auto& header : projectConfig.at("headers").get_array()) {
-            //    project.headers.push_back(header.get_string());
-            //    NCINFO("    + {}", header.get_string())
-            //}
+            std::string headerFileExt = ".nlh";
+            if (const auto* includeFiles = projectConfig.find("includeFiles"); includeFiles && includeFiles->is_string()) {
+                headerFileExt = includeFiles->get_string();
+            }
+            if (const auto* includeDirs = projectConfig.find("includeDirs"); includeDirs && includeDirs->is_array()) {
+                for (const auto& dir : includeDirs->get_array()) {
+                    const auto includeDir = absoluteProjectDir / dir.get_string();
+                    if (!std::filesystem::exists(includeDir)) continue;
+
+                    for (auto& header : discovery.find(includeDir, {"*" + headerFileExt})) {
+                        NCINFO("    + {}", std::filesystem::relative(header, includeDir).string());
+                        project.headers.push_back(std::move(header));
+                    }
+                }
+            }
 
 
             NCINFO("  └▶ Done");
@@ -144,63 +244,252 @@ namespace Nova::Compiler {
             _projects.push_back(project);
             
         }
+
+        NCINFO("Source discovery: {} directories read, {} unchanged", discovery.listedDirectories(), discovery.reusedDirectories());
     }
 
     void Compiler::generateAll(std::string_view outputPath) {
-        for (const auto& project : _projects) {
-            generateProject(project, outputPath);
+        beginGeneration();
+        queries().refresh(); // Sources read by an earlier build may have changed since
+
+        // Only builds write into the project, --check and the language server leave it untouched
+        if (_discovery) {
+            _discovery->save();
+            _discovery.reset();
+        }
+
+        // Libraries go before the projects using them, their interfaces have to exist first
+        std::vector<const Project*> order;
+        std::unordered_set<std::string> visited;
+        std::function<void(const Project&)> visit = [&](const Project& project) {
+            if (!visited.insert(project.name).second) return;
+            for (const auto& dependency : project.dependencies) {
+                auto it = std::find_if(_projects.begin(), _projects.end(), [&](const Project& p) { return p.name == dependency; });
+                if (it != _projects.end()) visit(*it);
+            }
+            order.push_back(&project);
+        };
+        for (const auto& project : _projects) visit(project);
+
+        for (const auto* project : order) {
+            generateProject(*project, outputPath);
+            if (project->type == ProjectType::Library) writeInterface(*project, outputPath);
         }
+
+        // The build is only done once its artifacts are on disk
+        _writer.flush();
+        const auto stats = _writer.takeStats();
+        NCINFO("Wrote {} artifacts ({} unchanged{})", stats.written, stats.unchanged,
+               stats.failed ? fmt::format(", {} failed", stats.failed) : "");
     }
 
     void Compiler::generateProject(const Project& project, std::string_view outputPath) {
         NCINFO("◁ ─┬─Compiling: {}───▷", project.name);
+
+        // Declarations of every file first, calls across files need the callee's signature
+        _declarations.clear();
+        for (auto& decl : readDeclarations(project.files)) {
+            _declarations[decl.name] = std::move(decl);
+        }
+
+        std::vector<std::string> names;
+        for (const auto& [name, decl] : _declarations) names.push_back(name);
+        std::sort(names.begin(), names.end());
+        _declarationsSalt = hashText(project.name);
+        for (const auto& name : names) {
+            const auto& decl = _declarations.at(name);
+            _declarationsSalt = hashText(decl.returnType, hashText(decl.name, _declarationsSalt));
+            for (const auto& arg : decl.args) _declarationsSalt = hashText(arg, _declarationsSalt);
+        }
+
+        // Dependencies are only known through their interface, its hash stands in for all their sources
+        _imports.clear();
+        if (!project.dependencies.empty()) _writer.flush(); // Interfaces of the dependencies may still be queued
+        for (const auto& dependency : project.dependencies) {
+            const auto path = std::filesystem::path(outputPath) / (dependency + ".nli");
+            auto interface = InterfaceFile::open(path);
+            if (!interface) {
+                NERROR("  Missing or invalid interface for {}: {}", dependency, path.string());
+                continue;
+            }
+            _declarationsSalt = hashText(fmt::format("{:016x}", interface->hash()), _declarationsSalt);
+            _imports.push_back(std::move(*interface));
+        }
+
+        // Executables only generate what main can reach, shared source sets often bring far more
+        _treeShaking = project.type == ProjectType::Executable && _options.treeShaking;
+        if (_treeShaking) {
+            _reachable = reachableFunctions(project);
+            const auto kept = std::count_if(_declarations.begin(), _declarations.end(),
+                                            [this](const auto& entry) { return _reachable.contains(entry.first); });
+            NCINFO("  Tree shaking: {} of {} functions reachable", kept, _declarations.size());
+        }
+
+        // Several targets in nc.conf: the modules are retargeted instead of running the frontend again
+        const bool multiTarget = _configTargets.size() > 1 && _options.target.triple.empty();
+
+        std::vector<llvm::Module*> modules;
+        std::vector<std::unique_ptr<llvm::Module>> owned; // Modules built without the incremental cache
         int x = 0;
         for (const auto& file : project.files){
             std::string log;
             if (project.files.size() != (x+1)) {log = fmt::format("   ├─➤ {}", std::filesystem::path(file).filename().string());}
             else {log = fmt::format("   └─➤ {}", std::filesystem::path(file).filename().string());}
             NCINFO("{}", log);
-            auto module = std::make_unique<llvm::Module>(project.name, context);
 
-            // compileToIR(file, outputPath, module.get());
+            llvm::Module* module = nullptr;
+            if (_options.incremental) {
+                auto& cache = acquireModuleCache(project, outputPath, file);
+                _activeCache = &cache;
+                prepareModule(cache.module.get(), file);
+                _activeCache = nullptr;
 
-            // Write the IR to a file
-            std::filesystem::path irPath = std::filesystem::path(outputPath) / (std::filesystem::path(file).stem().string() + ".ll");
-            std::ofstream irFile(irPath);
-            if (irFile.is_open()) {
-                irFile << compileToIR(file, outputPath, module.get());
-                irFile.close();
+                // Simplification uses this target's TTI, with several targets every backend optimizes its own copy
+                if (!multiTarget) optimizeFunctions(*cache.module, cache.dirty);
+                module = cache.module.get();
             }else {
-                NERROR("  Failed to write IR file: {}", irPath.string());
+                owned.push_back(std::make_unique<llvm::Module>(project.name, llvmContext()));
+                module = owned.back().get();
+                prepareModule(module, file);
             }
 
             if (llvm::verifyModule(*module, &llvm::errs())) {
                 NERROR("  Module verification failed aborting");
+                _moduleCache.erase(file);
                 return;
-                assert(false);
-            }else {
-                // printf("\033[%dA\r\033[%zuC   \033[1;97;42m ✔ DONE \033[0m\n", logLinesPrinted, offset);
-                // NCINFO("\033[{}A\r\033[{}C   \033[1;97;42m ✔ DONE \033[0m\n", logLinesPrinted, offset);
             }
+            if (_options.incremental) saveModuleCache(project, outputPath, file, _moduleCache.at(file));
+
+            modules.push_back(module);
             x++;
         }
+        _treeShaking = false;
+
+        const auto outDir = std::filesystem::path(outputPath);
+        if (multiTarget) {
+            emitForTargets(project, modules, outDir);
+        }else {
+            emitProject(project, modules, outDir);
+        }
         NCINFO("◁ ───Finished compiling: {}───▷", project.name);
     }
 
-    std::string Compiler::compileToIR(std::string_view filePath, std::string_view outputPath, llvm::Module* module) {
+    // Optimization and output of a project's modules according to its LTO mode
+    void Compiler::emitProject(const Project& project, const std::vector<llvm::Module*>& modules, const std::filesystem::path& outDir) {
+        // Libraries always need machine code (or bitcode with ThinLTO), it goes into the archive or shared object
+        const bool library = project.type == ProjectType::Library;
+        std::vector<ObjectBuffer> members;
+        auto emitObject = [&](const std::string& stem, const llvm::Module& output) {
+            if (!library && !_options.emitObjects) return;
+            const auto path = outDir / (stem + ".o");
+            auto object = objectFile(path, output);
+            if (_options.emitObjects) writeObject(path, object);
+            // Members only carry the file name, an archive may hold two of the same name
+            if (library) members.push_back(ObjectBuffer{path.filename().string(), std::move(object)});
+        };
+
+        // Modules arrive in the order of project.files
+        const auto stems = outputStems(project);
+        for (const auto& stem : stems) {
+            const auto parent = std::filesystem::path(stem).parent_path();
+            std::error_code ec;
+            if (!parent.empty()) std::filesystem::create_directories(outDir / parent, ec);
+        }
 
-    
-        llvm::IRBuilder<> builder(context);
+        // Cached modules must survive the build: linkage, calling conventions and module passes only
+        // ever touch copies, a later rebuild would otherwise call fastcc functions from fresh C bodies
+        std::vector<std::unique_ptr<llvm::Module>> copies;
+        std::vector<llvm::Module*> outputs;
+        for (auto* module : modules) {
+            copies.push_back(llvm::CloneModule(*module));
+            outputs.push_back(copies.back().get());
+        }
+        inferLinkage(project, outputs);
+
+        switch (resolveLTOMode(project)) {
+            case LTOMode::Full: {
+                for (auto& copy : copies) optimizeModule(*copy, llvm::ThinOrFullLTOPhase::FullLTOPreLink);
+                auto linked = linkProject(project, std::move(copies));
+                if (!linked) return;
+                // Whole project in one module, everything but the exports can be internal now
+                inferLinkage(project, {linked.get()});
+                optimizeModule(*linked, llvm::ThinOrFullLTOPhase::FullLTOPostLink);
+                writeIR(outDir / (project.name + ".ll"), *linked);
+                emitObject(project.name, *linked);
+                break;
+            }
+            case LTOMode::Thin:
+                for (size_t i = 0; i < copies.size(); i++) {
+                    auto& copy = copies[i];
+                    optimizeModule(*copy, llvm::ThinOrFullLTOPhase::ThinLTOPreLink);
+                    const auto path = outDir / (stems[i] + ".bc");
+                    auto bitcode = thinLTOBitcode(*copy);
+                    if (library) members.push_back(ObjectBuffer{path.filename().string(), bitcode});
+                    _writer.submit(path, std::move(bitcode));
+                }
+                break;
+            default:
+                for (size_t i = 0; i < copies.size(); i++) {
+                    auto& copy = copies[i];
+                    // Per-function simplification of cached bodies has no inliner or IPO, outputs get the module pipeline
+                    if (_options.optLevel > 0 || usesProfile()) optimizeModule(*copy);
+
+                    writeIR(outDir / (stems[i] + ".ll"), *copy);
+                    emitObject(stems[i], *copy);
+                }
+                break;
+        }
 
-        llvm::Triple triple("aarch64-unknown-linux-gnu");
-        module->setTargetTriple(triple);
-        module->setDataLayout("e-m:e-i64:64-i128:128-n32:64-S128");
-        module->setSourceFileName(std::filesystem::path(filePath).filename().string());
+        if (library) emitLibrary(project, members, outDir);
+    }
 
+    // Recursive discovery finds src/a/util.nl next to src/b/util.nl, named by their file alone their
+    // outputs would overwrite each other. "a/util" and "b/util" instead, the output directory mirrors the sources
+    std::vector<std::string> Compiler::outputStems(const Project& project) {
+        std::filesystem::path base = project.sourceDir;
+        if (base.empty() && !project.files.empty()) {
+            base = std::filesystem::path(project.files.front()).parent_path();
+            for (const auto& file : project.files) {
+                const auto parent = std::filesystem::path(file).parent_path();
+                std::filesystem::path common;
+                for (auto b = base.begin(), p = parent.begin(); b != base.end() && p != parent.end() && *b == *p; ++b, ++p) {
+                    common /= *p;
+                }
+                base = std::move(common);
+            }
+        }
 
+        std::vector<std::string> stems;
+        for (const auto& file : project.files) {
+            auto relative = std::filesystem::path(file).lexically_relative(base);
+            // Outside of sourceDir (or a relative path against an absolute one), only the name is left
+            if (relative.empty() || *relative.begin() == "..") relative = std::filesystem::path(file).filename();
+            stems.push_back(relative.replace_extension().generic_string());
+        }
+        return stems;
+    }
 
+    void Compiler::prepareModule(llvm::Module* module, std::string_view filePath) {
+        auto* machine = targetMachine();
+        if (machine) {
+            module->setTargetTriple(machine->getTargetTriple());
+            module->setDataLayout(machine->createDataLayout());
+        }
+        module->setSourceFileName(std::filesystem::path(filePath).filename().string());
 
         generateIR(module, filePath);
+    }
+
+    void Compiler::writeIR(const std::filesystem::path& path, const llvm::Module& module) {
+        std::string ir;
+        llvm::raw_string_ostream rso(ir);
+        module.print(rso, nullptr);
+        rso.flush();
+        _writer.submit(path, std::move(ir));
+    }
+
+    std::string Compiler::compileToIR(std::string_view filePath, std::string_view outputPath, llvm::Module* module) {
+        prepareModule(module, filePath);
 
         std::string ir;
         llvm::raw_string_ostream rso(ir);
@@ -213,33 +502,58 @@ namespace Nova::Compiler {
 
     void Compiler::generateHeaders(std::string_view outputPath) {
         NCINFO("Generating headers to {}", outputPath);
+        for (const auto& project : _projects) {
+            if (project.type == ProjectType::Library) writeInterface(project, outputPath);
+        }
     }
 
-    void Compiler::generateIR(llvm::Module* module, std::string_view sourcePath) {
+    // Binary interface of a library: its header declarations, or every function when it has no headers
+    void Compiler::writeInterface(const Project& project, std::string_view outputPath) {
+        const auto declarations = readDeclarations(project.headers.empty() ? project.files : project.headers);
+        auto blob = InterfaceFile::build(declarations);
+        const auto path = std::filesystem::path(outputPath) / (project.name + ".nli");
+
+        // An unchanged interface keeps its file, dependents see the same hash and reuse their cache
+        InterfaceHeader header{};
+        std::memcpy(&header, blob.data(), sizeof(header));
+        if (auto existing = InterfaceFile::open(path); existing && existing->hash() == header.hash) {
+            NCINFO("  Interface of {} unchanged", project.name);
+            return;
+        }
 
-        // open source file
+        _writer.submit(path, std::move(blob));
+        NCINFO("  Interface of {}: {} functions", project.name, declarations.size());
+    }
 
-        std::string filename = std::filesystem::path(sourcePath).string();
+    void Compiler::generateIR(llvm::Module* module, std::string_view sourcePath) {
 
-        std::ifstream file((std::filesystem::path(sourcePath)));
-        if (!file.is_open()) {
+        const std::string filename = std::filesystem::path(sourcePath).string();
+        if (!queries().readable(filename)) {
             NERROR("Failed to open source file: {}", sourcePath);
             return;
         }
 
-        std::string ir;
+        // Already split by the declaration queries of this build
+        generateIR(module, queries().lines(filename));
+    }
 
-        std::string line;
-        int lineNumber = 0;
-        std::vector<std::string> lines;
-        // push lines into lines vecto
-        while (std::getline(file, line)) {
-            lines.push_back(line);
+    void Compiler::generateIR(llvm::Module* module, const std::vector<std::string>& lines) {
+        collectDeclarations(lines);
+
+        // Any declaration change throws away the cached module, bodies are only reused when all signatures match
+        if (_activeCache) {
+            uint64_t salt = hashText(optionsKey(), _declarationsSalt);
+            for (const auto& l : lines) {
+                if (l.find("func ") != std::string::npos) salt = hashText(l.substr(0, l.find('{')), salt);
+            }
+            beginIncremental(module, salt);
         }
 
+        _sourceLines = &lines;
+        int lineNumber = 0;
         for (const auto& line : lines) {
 
-            if (line.find("func ") != std::string::npos) {
+            if (line.find("func ") != std::string::npos && isReachable(line)) {
                 auto func = parseFunction(lines, lineNumber, module);
                 // ir += func.ir;
                 
@@ -247,45 +561,17 @@ namespace Nova::Compiler {
 
             lineNumber++;
         }
+        _sourceLines = nullptr;
 
-        file.close();
-
-        return;
+        if (_treeShaking) dropUnreachable(module);
+        if (_activeCache) finishIncremental();
     }
 
 
     Function Compiler::parseFunction(const std::vector<std::string>& lines, int funcLine, llvm::Module* module) {
         Function func;
-        const auto& funcDefLine = lines[funcLine];
-        
-        // Split declaration from body
-        size_t bracePos = funcDefLine.find('{');
-        size_t closeBrace = funcDefLine.rfind('}');
-        
         std::string decl;
-        std::string parsedLine;
-        std::vector<std::string> code;
-        
-        // Extract declaration and inline code
-        if (bracePos != std::string::npos) {
-            decl = funcDefLine.substr(0, bracePos);
-            
-            // Check if function body is on same line
-            if (closeBrace != std::string::npos && closeBrace > bracePos) {
-                parsedLine = funcDefLine.substr(bracePos + 1, closeBrace - bracePos - 1);
-            }
-        } else {
-            decl = funcDefLine;
-        }
-        
-        
-        // If no inline code, extract multi-line body
-        if (trim(parsedLine).empty()) {
-            code = extractMultiLineBody(lines, funcLine + 1);
-        } else {
-            // Parse inline code by splitting on semicolons
-            code = splitStatements(parsedLine);
-        }
+        std::vector<std::string> code = functionBody(lines, funcLine, decl);
         
         // Parse function declaration
         FunctionDeclaration decl_info = parseFunctionDeclaration(decl);
@@ -298,26 +584,121 @@ namespace Nova::Compiler {
         func.returnType = decl_info.returnType;
         
         // Convert to LLVM type
-        llvm::Type* llvmReturnType = novaTypeToLLVM(func.returnType, context);
+        llvm::Type* llvmReturnType = novaTypeToLLVM(func.returnType, llvmContext());
         if (llvmReturnType == nullptr) {
-            NCERROR("Unknown return type: {}", func.returnType);
+            report("error", func.name, funcLine, fmt::format("Unknown return type: {}", func.returnType));
             return func;
         }
+
+        // Reuse the body from the previous build when nothing in the function changed
+        llvm::Function* function = module ? module->getFunction(func.name) : nullptr;
+        uint64_t fingerprint = 0;
+        if (_activeCache) {
+            fingerprint = hashText(decl, _activeCache->salt);
+            for (const auto& stmt : code) fingerprint = hashText(stmt, fingerprint);
+
+            const auto cached = _activeCache->fingerprints.find(func.name);
+            if (function && !function->isDeclaration() &&
+                cached != _activeCache->fingerprints.end() && cached->second == fingerprint) {
+                return func;
+            }
+        }
+
+        if (function) {
+            // Same signature is guaranteed by the salt (or the function was declared by a call), only the body is replaced
+            if (!function->isDeclaration()) function->deleteBody();
+        }else {
+            function = declareFunction(module, decl_info);
+            if (function == nullptr) return func;
+        }
         
-        // Create LLVM function
-        llvm::FunctionType* fnType = llvm::FunctionType::get(llvmReturnType, false);
+        // Generate function body IR
+        generateFunctionBody(code, function, llvmReturnType, func.name, funcLine, llvmContext());
+
+        if (_activeCache) {
+            _activeCache->fingerprints[func.name] = fingerprint;
+            _activeCache->dirty.push_back(func.name);
+        }
         
+        return func;
+    }
+
+    // Remembers the signature of every function in the given source lines
+    void Compiler::collectDeclarations(const std::vector<std::string>& lines) {
+        for (const auto& line : lines) {
+            if (line.find("func ") == std::string::npos) continue;
+
+            auto decl = parseFunctionDeclaration(line.substr(0, line.find_first_of("{;")), false);
+            if (decl.valid) _declarations[decl.name] = decl;
+        }
+    }
+
+    // Signatures of every function in the given files, only files that changed since the last call are parsed again
+    std::vector<FunctionDeclaration> Compiler::readDeclarations(const std::vector<std::string>& files) {
+        std::vector<FunctionDeclaration> declarations;
+        for (const auto& path : files) {
+            const auto& decls = queries().declarations(path);
+            declarations.insert(declarations.end(), decls.begin(), decls.end());
+        }
+        return declarations;
+    }
+
+    // Functions of this project first, then the interfaces of its dependencies
+    std::optional<FunctionDeclaration> Compiler::lookupDeclaration(const std::string& name) const {
+        if (const auto it = _declarations.find(name); it != _declarations.end()) return it->second;
+        for (const auto& interface : _imports) {
+            if (auto decl = interface.find(name)) return decl;
+        }
+        return std::nullopt;
+    }
+
+    // Creates the LLVM function for a declaration, or returns the one already in the module
+    llvm::Function* Compiler::declareFunction(llvm::Module* module, const FunctionDeclaration& decl) {
+        if (module) {
+            if (auto* existing = module->getFunction(decl.name)) return existing;
+        }
+
+        llvm::Type* returnType = novaTypeToLLVM(decl.returnType, llvmContext());
+        if (returnType == nullptr) {
+            report("error", fmt::format("Unknown return type: {}", decl.returnType));
+            return nullptr;
+        }
+
+        // Arguments are written "type name", a bare name is an int
+        std::vector<llvm::Type*> paramTypes;
+        std::vector<std::string> paramNames;
+        for (const auto& arg : decl.args) {
+            const auto parts = tokenize(arg);
+            const std::string typeName = parts.size() > 1 ? parts[0] : "int";
+            llvm::Type* paramType = novaTypeToLLVM(typeName, llvmContext());
+            if (paramType == nullptr || paramType->isVoidTy()) {
+                report("error", fmt::format("Unknown argument type: {}", typeName));
+                return nullptr;
+            }
+            paramTypes.push_back(paramType);
+            paramNames.push_back(parts.back());
+        }
+
+        // Create LLVM function
+        llvm::FunctionType* fnType = llvm::FunctionType::get(returnType, paramTypes, false);
+
         llvm::Function* function = llvm::Function::Create(
             fnType,
             llvm::Function::ExternalLinkage,
-            func.name,
+            decl.name,
             module
         );
-        
-        // Generate function body IR
-        generateFunctionBody(code, function, llvmReturnType, func.name, funcLine, context);
-        
-        return func;
+        for (size_t i = 0; i < paramNames.size(); i++) {
+            function->getArg(i)->setName(paramNames[i]);
+        }
+
+        // Lets the optimizer and backend tune for the selected CPU
+        if (auto* machine = targetMachine()) {
+            if (!machine->getTargetCPU().empty()) function->addFnAttr("target-cpu", machine->getTargetCPU());
+            if (!machine->getTargetFeatureString().empty()) function->addFnAttr("target-features", machine->getTargetFeatureString());
+        }
+
+        return function;
     }
         
 };
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "discovery.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/GlobPattern.h>
+#include <thread>
+
+namespace Nova::Compiler {
+
+static constexpr const char* SNAPSHOT_MAGIC = "nova-src 1";
+static constexpr size_t MAX_WALK_THREADS = 8;
+
+// Directories changed this close to the walk may change again within the same timestamp tick
+// (coarse mtimes on some filesystems), their listings are not trusted next run
+static constexpr int64_t RACY_WINDOW_NS = 2'000'000'000;
+
+static int64_t toNanoseconds(std::filesystem::file_time_type time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+static std::vector<llvm::GlobPattern> compileGlobs(const std::vector<std::string>& globs) {
+    std::vector<llvm::GlobPattern> patterns;
+    for (const auto& glob : globs) {
+        auto pattern = llvm::GlobPattern::create(glob);
+        if (!pattern) {
+            NCWARN("Ignoring invalid glob '{}': {}", glob, llvm::toString(pattern.takeError()));
+            continue;
+        }
+        patterns.push_back(std::move(*pattern));
+    }
+    return patterns;
+}
+
+static bool matchesAny(const std::vector<llvm::GlobPattern>& patterns, const std::string& path) {
+    return std::any_of(patterns.begin(), patterns.end(), [&](const llvm::GlobPattern& pattern) { return pattern.match(path); });
+}
+
+SourceDiscovery::SourceDiscovery(std::filesystem::path snapshotPath) : _snapshotPath(std::move(snapshotPath)) {
+    _startTime = toNanoseconds(std::filesystem::file_time_type::clock::now());
+    load();
+}
+
+// "D <mtime> <path>" followed by "f <name>" and "d <name>" lines for its entries
+void SourceDiscovery::load() {
+    std::ifstream file(_snapshotPath);
+    std::string line;
+    if (!std::getline(file, line) || line != SNAPSHOT_MAGIC) return;
+
+    Listing* current = nullptr;
+    while (std::getline(file, line)) {
+        if (line.size() < 2) continue;
+        if (line[0] == 'D') {
+            const size_t space = line.find(' ', 2);
+            if (space == std::string::npos) continue;
+            Listing listing;
+            listing.mtime = std::strtoll(line.c_str() + 2, nullptr, 10);
+            current = &(_snapshot[line.substr(space + 1)] = std::move(listing));
+        }else if (current && line[0] == 'f') {
+            current->files.push_back(line.substr(2));
+        }else if (current && line[0] == 'd') {
+            current->directories.push_back(line.substr(2));
+        }
+    }
+}
+
+void SourceDiscovery::save() {
+    // Same directories with the same listings, nothing to write
+    if (!_changed && _current.size() == _snapshot.size()) return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(_snapshotPath.parent_path(), ec);
+    std::ofstream file(_snapshotPath, std::ios::trunc);
+    if (!file.is_open()) return;
+
+    file << SNAPSHOT_MAGIC << "\n";
+    for (const auto& [directory, listing] : _current) {
+        file << "D " << listing.mtime << " " << directory << "\n";
+        for (const auto& name : listing.files) file << "f " << name << "\n";
+        for (const auto& name : listing.directories) file << "d " << name << "\n";
+    }
+}
+
+// One stat for an unchanged directory, a full read otherwise
+SourceDiscovery::Listing SourceDiscovery::list(const std::filesystem::path& directory) {
+    const auto key = directory.string();
+
+    std::error_code ec;
+    const int64_t mtime = toNanoseconds(std::filesystem::last_write_time(directory, ec));
+    if (ec) return {};
+
+    if (const auto it = _snapshot.find(key); it != _snapshot.end() && it->second.mtime != 0 && it->second.mtime == mtime) {
+        std::lock_guard lock(_mutex);
+        _reused++;
+        _current[key] = it->second;
+        return it->second;
+    }
+
+    Listing listing;
+    listing.mtime = _startTime - mtime < RACY_WINDOW_NS ? 0 : mtime;
+    // No range-for, operator++ throws on a read error and this runs on the walk's pool threads
+    std::filesystem::directory_iterator it(directory, std::filesystem::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        std::error_code entryEc;
+        const auto name = it->path().filename().string();
+        // Symlinked directories are not followed, they could form cycles
+        if (it->is_directory(entryEc) && !it->is_symlink(entryEc)) {
+            listing.directories.push_back(name);
+        }else if (it->is_regular_file(entryEc)) {
+            listing.files.push_back(name);
+        }
+    }
+    // A listing cut short is as good as none, and must not be remembered for the next run
+    if (ec) return {};
+
+    std::lock_guard lock(_mutex);
+    _listed++;
+    _changed = true;
+    _current[key] = listing;
+    return listing;
+}
+
+std::vector<std::string> SourceDiscovery::find(const std::filesystem::path& root,
+                                               const std::vector<std::string>& include,
+                                               const std::vector<std::string>& exclude) {
+    const auto includes = compileGlobs(include);
+    const auto excludes = compileGlobs(exclude);
+
+    // Queue of (absolute directory, path relative to root)
+    std::deque<std::pair<std::filesystem::path, std::string>> queue{{root, ""}};
+    std::vector<std::string> found;
+    size_t active = 0;
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    auto worker = [&]() {
+        while (true) {
+            std::pair<std::filesystem::path, std::string> directory;
+            {
+                std::unique_lock lock(mutex);
+                wake.wait(lock, [&]() { return !queue.empty() || active == 0; });
+                if (queue.empty()) return;
+                directory = std::move(queue.front());
+                queue.pop_front();
+                active++;
+            }
+
+            const auto& [path, relative] = directory;
+            const auto listing = list(path);
+
+            std::vector<std::pair<std::filesystem::path, std::string>> subdirectories;
+            std::vector<std::string> files;
+            for (const auto& name : listing.directories) {
+                auto childRelative = relative.empty() ? name : relative + "/" + name;
+                if (name.front() == '.' || matchesAny(excludes, childRelative)) continue;
+                subdirectories.emplace_back(path / name, std::move(childRelative));
+            }
+            for (const auto& name : listing.files) {
+                const auto childRelative = relative.empty() ? name : relative + "/" + name;
+                if (matchesAny(includes, childRelative) && !matchesAny(excludes, childRelative)) {
+                    files.push_back((path / name).string());
+                }
+            }
+
+            {
+                std::lock_guard lock(mutex);
+                for (auto& subdirectory : subdirectories) queue.push_back(std::move(subdirectory));
+                found.insert(found.end(), std::make_move_iterator(files.begin()), std::make_move_iterator(files.end()));
+                active--;
+            }
+            wake.notify_all();
+        }
+    };
+
+    const size_t threads = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, MAX_WALK_THREADS);
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < threads; i++) pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool) thread.join();
+
+    // Walk order depends on scheduling, the build must not
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+} // namespace Nova::Compiler
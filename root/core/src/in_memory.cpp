@@ -0,0 +1,79 @@
+#include "compiler.h"
+#include "interface.h"
+#include "logger.h"
+#include <algorithm>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
+#include <sstream>
+
+namespace Nova::Compiler {
+
+static std::vector<std::string> splitLines(const std::string& contents) {
+    std::vector<std::string> lines;
+    std::istringstream stream(contents);
+    std::string line;
+    while (std::getline(stream, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+CompileResult Compiler::generateCode(std::string code) {
+    return compile({VirtualFile{"<memory>", std::move(code)}});
+}
+
+// Every file goes into one module, diagnostics are collected instead of printed and nothing touches the disk
+CompileResult Compiler::compile(const std::vector<VirtualFile>& files, bool emitObject) {
+    CompileResult result;
+
+    std::vector<std::vector<std::string>> sources;
+    _declarations.clear();
+    _imports.clear();
+    _diagnostics = &result.diagnostics;
+    for (const auto& file : files) {
+        _diagnosticFile = file.name;
+        sources.push_back(splitLines(file.contents));
+        collectDeclarations(sources.back());
+    }
+
+    auto module = std::make_unique<llvm::Module>(files.size() == 1 ? files.front().name : "memory", llvmContext());
+    result.context = context; // Recycling the compiler's context must not pull it from under the result
+    if (auto* machine = targetMachine()) {
+        module->setTargetTriple(machine->getTargetTriple());
+        module->setDataLayout(machine->createDataLayout());
+    }
+    if (files.size() == 1) module->setSourceFileName(files.front().name);
+
+    for (size_t i = 0; i < files.size(); i++) {
+        _diagnosticFile = files[i].name;
+        generateIR(module.get(), sources[i]);
+    }
+    _diagnosticFile.clear();
+
+    bool failed = std::any_of(result.diagnostics.begin(), result.diagnostics.end(),
+                              [](const ParseError& error) { return error.severity == "error"; });
+    if (!failed) {
+        std::string verifierOutput;
+        llvm::raw_string_ostream verifier(verifierOutput);
+        if (llvm::verifyModule(*module, &verifier)) {
+            verifier.flush();
+            report("error", fmt::format("Module verification failed: {}", verifierOutput));
+            failed = true;
+        }
+    }
+
+    if (!failed) {
+        if (_options.optLevel > 0 || usesProfile()) optimizeModule(*module);
+        if (emitObject) {
+            result.object = emitObjectFile(*module);
+            failed = result.object.empty();
+        }
+    }
+    _diagnostics = nullptr;
+
+    if (!failed) result.module = std::move(module);
+    return result;
+}
+
+} // namespace Nova::Compiler
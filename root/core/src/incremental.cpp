@@ -0,0 +1,132 @@
+#include "compiler.h"
+#include "logger.h"
+#include <filesystem>
+#include <fstream>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cstdlib>
+#include <sstream>
+
+namespace Nova::Compiler {
+
+// Directory inside the output path holding cached modules between CLI runs
+static constexpr const char* CACHE_DIR = ".nova-cache";
+static constexpr const char* CACHE_MAGIC = "nova-fp 1";
+
+// FNV-1a, stable across runs so fingerprints can be stored on disk
+uint64_t Compiler::hashText(std::string_view text, uint64_t seed) {
+    uint64_t hash = seed;
+    for (const unsigned char c : text) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    // Separator so ("ab", "c") and ("a", "bc") hash differently
+    hash ^= 0xff;
+    hash *= 0x100000001b3ULL;
+    return hash;
+}
+
+// Everything besides the source text that changes the generated code
+std::string Compiler::optionsKey() const {
+    const auto target = resolveTarget();
+    return fmt::format("O{};{};{};{};{}", _options.optLevel, target.triple, target.cpu, target.features, target.os);
+}
+
+std::filesystem::path Compiler::cachePath(const Project& project, std::string_view outputPath, const std::string& file) const {
+    const auto stem = std::filesystem::path(file).stem().string();
+    return std::filesystem::path(outputPath) / CACHE_DIR / project.name / fmt::format("{}-{:016x}", stem, hashText(file));
+}
+
+// Returns the in-memory cache for a file, loading the on-disk copy on first use
+ModuleCache& Compiler::acquireModuleCache(const Project& project, std::string_view outputPath, const std::string& file) {
+    auto [it, inserted] = _moduleCache.try_emplace(file);
+    auto& cache = it->second;
+    if (!inserted && cache.module) return cache;
+
+    // Serialized by a context recycle, bring it back into the new context
+    if (!cache.bitcode.empty()) {
+        auto module = llvm::parseBitcodeFile(llvm::MemoryBufferRef(cache.bitcode, file), llvmContext());
+        cache.bitcode.clear();
+        if (module) {
+            cache.module = std::move(*module);
+            cache.module->setModuleIdentifier(project.name);
+            return cache;
+        }
+        llvm::consumeError(module.takeError());
+    }
+
+    const auto base = cachePath(project, outputPath, file);
+    std::ifstream fpFile(base.string() + ".fp");
+    auto buffer = llvm::MemoryBuffer::getFile(base.string() + ".bc");
+    if (fpFile.is_open() && buffer) {
+        std::string line;
+        std::getline(fpFile, line);
+        if (line == CACHE_MAGIC) {
+            auto module = llvm::parseBitcodeFile((*buffer)->getMemBufferRef(), llvmContext());
+            if (module) {
+                std::getline(fpFile, line);
+                cache.salt = std::strtoull(line.c_str(), nullptr, 16);
+                while (std::getline(fpFile, line)) {
+                    std::istringstream iss(line);
+                    std::string name, hash;
+                    if (iss >> name >> hash) cache.fingerprints[name] = std::strtoull(hash.c_str(), nullptr, 16);
+                }
+                cache.module = std::move(*module);
+                cache.module->setModuleIdentifier(project.name);
+                return cache;
+            }
+            llvm::consumeError(module.takeError());
+        }
+        NWARN("  Ignoring stale cache for {}", file);
+    }
+
+    cache.module = std::make_unique<llvm::Module>(project.name, llvmContext());
+    cache.salt = 0;
+    cache.fingerprints.clear();
+    return cache;
+}
+
+void Compiler::saveModuleCache(const Project& project, std::string_view outputPath, const std::string& file, const ModuleCache& cache) {
+    // Nothing changed, the files on disk are still current
+    if (cache.dirty.empty()) return;
+
+    const auto base = cachePath(project, outputPath, file);
+    std::error_code ec;
+    std::filesystem::create_directories(base.parent_path(), ec);
+
+    std::string bitcode;
+    llvm::raw_string_ostream bc(bitcode);
+    llvm::WriteBitcodeToFile(*cache.module, bc);
+    bc.flush();
+    _writer.submit(base.string() + ".bc", std::move(bitcode));
+
+    std::string fingerprints = fmt::format("{}\n{:016x}\n", CACHE_MAGIC, cache.salt);
+    for (const auto& [name, hash] : cache.fingerprints) {
+        fingerprints += fmt::format("{} {:016x}\n", name, hash);
+    }
+    _writer.submit(base.string() + ".fp", std::move(fingerprints));
+}
+
+void Compiler::beginIncremental(llvm::Module* module, uint64_t salt) {
+    _activeCache->dirty.clear();
+    if (_activeCache->salt == salt) return;
+
+    // Signatures changed, callers may hold calls with the old types so start over
+    for (auto& function : *module) function.dropAllReferences();
+    while (!module->empty()) module->begin()->eraseFromParent();
+    _activeCache->fingerprints.clear();
+    _activeCache->salt = salt;
+}
+
+void Compiler::finishIncremental() {
+    const size_t total = _activeCache->fingerprints.size();
+    const size_t regenerated = _activeCache->dirty.size();
+    if (regenerated < total) {
+        NCINFO("      Reused {} of {} functions", total - regenerated, total);
+    }
+}
+
+} // namespace Nova::Compiler
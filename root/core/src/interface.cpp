@@ -0,0 +1,126 @@
+#include "interface.h"
+#include <algorithm>
+#include <cstring>
+#include <llvm/Support/xxhash.h>
+#include <unordered_map>
+
+namespace Nova::Compiler {
+
+static constexpr char INTERFACE_MAGIC[4] = {'N', 'V', 'I', 1};
+
+std::string InterfaceFile::build(std::vector<FunctionDeclaration> functions) {
+    std::sort(functions.begin(), functions.end(), [](const auto& a, const auto& b) { return a.name < b.name; });
+
+    std::vector<InterfaceSymbol> symbols;
+    std::vector<InterfaceArg> args;
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> interned;
+
+    auto intern = [&](const std::string& str) {
+        auto [it, inserted] = interned.try_emplace(str, static_cast<uint32_t>(strings.size()));
+        if (inserted) {
+            strings += str;
+            strings += '\0';
+        }
+        return it->second;
+    };
+
+    for (const auto& function : functions) {
+        InterfaceSymbol symbol{};
+        symbol.id = llvm::xxh3_64bits(llvm::StringRef(function.name));
+        symbol.name = intern(function.name);
+        symbol.returnType = intern(function.returnType);
+        symbol.firstArg = static_cast<uint32_t>(args.size());
+        symbol.argCount = static_cast<uint32_t>(function.args.size());
+        for (const auto& arg : function.args) args.push_back(InterfaceArg{intern(arg)});
+        symbols.push_back(symbol);
+    }
+    if (strings.empty()) strings += '\0';
+
+    std::string body;
+    body.append(reinterpret_cast<const char*>(symbols.data()), symbols.size() * sizeof(InterfaceSymbol));
+    body.append(reinterpret_cast<const char*>(args.data()), args.size() * sizeof(InterfaceArg));
+    body += strings;
+
+    InterfaceHeader header{};
+    std::memcpy(header.magic, INTERFACE_MAGIC, sizeof(INTERFACE_MAGIC));
+    header.symbolCount = static_cast<uint32_t>(symbols.size());
+    header.argCount = static_cast<uint32_t>(args.size());
+    header.stringsSize = static_cast<uint32_t>(strings.size());
+    header.hash = llvm::xxh3_64bits(llvm::StringRef(body));
+
+    std::string blob(reinterpret_cast<const char*>(&header), sizeof(header));
+    blob += body;
+    return blob;
+}
+
+// Maps the file and checks every offset once so lookups can trust it afterwards
+std::optional<InterfaceFile> InterfaceFile::open(const std::filesystem::path& path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path.string(), false, false);
+    if (!buffer) return std::nullopt;
+
+    const auto size = (*buffer)->getBufferSize();
+    if (size < sizeof(InterfaceHeader)) return std::nullopt;
+
+    InterfaceFile file(std::move(*buffer));
+    const auto& header = file.header();
+    if (std::memcmp(header.magic, INTERFACE_MAGIC, sizeof(INTERFACE_MAGIC)) != 0) return std::nullopt;
+
+    const size_t expected = sizeof(InterfaceHeader) +
+                            size_t(header.symbolCount) * sizeof(InterfaceSymbol) +
+                            size_t(header.argCount) * sizeof(InterfaceArg) +
+                            header.stringsSize;
+    if (expected != size || header.stringsSize == 0) return std::nullopt;
+    if (file.string(0)[header.stringsSize - 1] != '\0') return std::nullopt;
+
+    for (uint32_t i = 0; i < header.symbolCount; i++) {
+        const auto& symbol = file.symbols()[i];
+        if (symbol.name >= header.stringsSize || symbol.returnType >= header.stringsSize) return std::nullopt;
+        if (size_t(symbol.firstArg) + symbol.argCount > header.argCount) return std::nullopt;
+    }
+    for (uint32_t i = 0; i < header.argCount; i++) {
+        if (file.args()[i].decl >= header.stringsSize) return std::nullopt;
+    }
+
+    return file;
+}
+
+FunctionDeclaration InterfaceFile::declaration(size_t index) const {
+    const auto& symbol = symbols()[index];
+    FunctionDeclaration decl;
+    decl.name = string(symbol.name);
+    decl.returnType = string(symbol.returnType);
+    for (uint32_t i = 0; i < symbol.argCount; i++) {
+        decl.args.push_back(string(args()[symbol.firstArg + i].decl));
+    }
+    return decl;
+}
+
+// Symbols are sorted by name, so a lookup never touches more than log(n) entries
+std::optional<FunctionDeclaration> InterfaceFile::find(std::string_view name) const {
+    const auto* begin = symbols();
+    const auto* end = begin + size();
+    const auto* it = std::lower_bound(begin, end, name, [this](const InterfaceSymbol& symbol, std::string_view key) {
+        return std::string_view(string(symbol.name)) < key;
+    });
+    if (it == end || std::string_view(string(it->name)) != name) return std::nullopt;
+    return declaration(static_cast<size_t>(it - begin));
+}
+
+const InterfaceHeader& InterfaceFile::header() const {
+    return *reinterpret_cast<const InterfaceHeader*>(_buffer->getBufferStart());
+}
+
+const InterfaceSymbol* InterfaceFile::symbols() const {
+    return reinterpret_cast<const InterfaceSymbol*>(_buffer->getBufferStart() + sizeof(InterfaceHeader));
+}
+
+const InterfaceArg* InterfaceFile::args() const {
+    return reinterpret_cast<const InterfaceArg*>(symbols() + header().symbolCount);
+}
+
+const char* InterfaceFile::string(uint32_t offset) const {
+    return reinterpret_cast<const char*>(args() + header().argCount) + offset;
+}
+
+} // namespace Nova::Compiler
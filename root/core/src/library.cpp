@@ -0,0 +1,69 @@
+#include "compiler.h"
+#include "logger.h"
+#include <algorithm>
+#include <llvm/Object/ArchiveWriter.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/TargetParser/Triple.h>
+
+namespace Nova::Compiler {
+
+// lib<name>.a or lib<name>.so next to the per-file outputs, <name>.lib on Windows
+void Compiler::emitLibrary(const Project& project, const std::vector<ObjectBuffer>& members, const std::filesystem::path& outDir) {
+    if (members.empty()) return;
+    if (std::any_of(members.begin(), members.end(), [](const ObjectBuffer& member) { return member.bytes.empty(); })) {
+        NERROR("  Library {} not written, code generation failed for some of its files", project.name);
+        return;
+    }
+
+    const llvm::Triple triple(resolveTarget().triple);
+    if (project.libType.value_or(LibraryType::Static) == LibraryType::Dynamic) {
+        if (!triple.isOSBinFormatELF()) {
+            NERROR("  Shared library {}: only ELF targets are supported, {} is not one", project.name, triple.str());
+            return;
+        }
+        writeSharedLibrary(outDir / fmt::format("lib{}.so", project.name), members);
+        return;
+    }
+
+    const auto name = triple.isOSWindows() ? project.name + ".lib" : fmt::format("lib{}.a", project.name);
+    writeArchive(outDir / name, members);
+}
+
+// Built in memory with a symbol index so linkers resolve members without running ranlib.
+// Deterministic headers (no timestamps, uids) keep an unchanged library byte for byte the same
+void Compiler::writeArchive(const std::filesystem::path& path, const std::vector<ObjectBuffer>& members) {
+    std::vector<llvm::NewArchiveMember> archiveMembers;
+    for (const auto& member : members) {
+        archiveMembers.emplace_back(llvm::MemoryBufferRef(member.bytes, member.name));
+    }
+
+    const llvm::Triple triple(resolveTarget().triple);
+    const auto kind = triple.isOSDarwin() ? llvm::object::Archive::K_DARWIN
+                    : triple.isOSWindows() ? llvm::object::Archive::K_COFF
+                    : llvm::object::Archive::K_GNU;
+
+    auto archive = llvm::writeArchiveToBuffer(archiveMembers, llvm::SymtabWritingMode::NormalSymtab, kind, true, false);
+    if (!archive) {
+        NERROR("  Failed to create {}: {}", path.filename().string(), llvm::toString(archive.takeError()));
+        return;
+    }
+
+    NCINFO("  Archive {}: {} members", path.filename().string(), members.size());
+    _writer.submit(path, std::string((*archive)->getBuffer()));
+}
+
+// Objects are already position independent (see createTargetMachine), the system linker only has to
+// put them together. ThinLTO members are bitcode and need ld.lld
+void Compiler::writeSharedLibrary(const std::filesystem::path& path, const std::vector<ObjectBuffer>& members) {
+    std::string error;
+    auto library = link({"-shared", "-soname", path.filename().string()}, members, error);
+    if (library.empty()) {
+        NERROR("  Failed to link {}: {}", path.filename().string(), error);
+        return;
+    }
+
+    NCINFO("  Shared library {}: {} objects", path.filename().string(), members.size());
+    _writer.submit(path, std::move(library));
+}
+
+} // namespace Nova::Compiler
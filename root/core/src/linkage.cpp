@@ -0,0 +1,64 @@
+#include "compiler.h"
+#include "logger.h"
+#include <llvm/IR/CallingConv.h>
+#include <llvm/IR/InstrTypes.h>
+
+namespace Nova::Compiler {
+
+// Functions callable from outside the project: main for executables,
+// the functions declared in the headers for libraries
+std::unordered_set<std::string> Compiler::exportedFunctions(const Project& project) {
+    std::unordered_set<std::string> exported;
+    if (project.type == ProjectType::Executable) {
+        exported.insert("main");
+        return exported;
+    }
+
+    for (const auto& decl : readDeclarations(project.headers)) {
+        exported.insert(decl.name);
+    }
+    return exported;
+}
+
+// Internal linkage for functions only used in their own module, hidden visibility for the
+// ones shared between files and fastcc for everything the outside world can not call
+void Compiler::inferLinkage(const Project& project, const std::vector<llvm::Module*>& modules) {
+    // A library without headers has no declared API, keep every function visible
+    if (project.type == ProjectType::Library && project.headers.empty()) return;
+
+    const auto exported = exportedFunctions(project);
+
+    std::unordered_set<std::string> sharedBetweenFiles;
+    for (const auto* module : modules) {
+        for (const auto& function : *module) {
+            if (function.isDeclaration()) sharedBetweenFiles.insert(function.getName().str());
+        }
+    }
+
+    for (auto* module : modules) {
+        for (auto& function : *module) {
+            const auto name = function.getName().str();
+            if (exported.contains(name) || function.isIntrinsic()) continue;
+            // Imported from a dependency, its calling convention belongs to the library
+            if (function.isDeclaration() && !_declarations.contains(name)) continue;
+
+            function.setCallingConv(llvm::CallingConv::Fast);
+            for (auto* user : function.users()) {
+                if (auto* call = llvm::dyn_cast<llvm::CallBase>(user); call && call->getCalledFunction() == &function) {
+                    call->setCallingConv(llvm::CallingConv::Fast);
+                }
+            }
+
+            if (function.isDeclaration()) continue;
+            if (sharedBetweenFiles.contains(name)) {
+                function.setLinkage(llvm::GlobalValue::ExternalLinkage);
+                function.setVisibility(llvm::GlobalValue::HiddenVisibility);
+                function.setDSOLocal(true);
+            }else {
+                function.setLinkage(llvm::GlobalValue::InternalLinkage);
+            }
+        }
+    }
+}
+
+} // namespace Nova::Compiler
@@ -1,7 +1,14 @@
 #include "compiler.h"
+#include "interface.h"
 #include "logger.h"
 #include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/IR/DerivedTypes.h>
 #include <sstream>
+#include <string_view>
 #include <sys/select.h>
 #include <unordered_set>
 #include <vector>
@@ -87,13 +94,33 @@ std::vector<std::string> Compiler::extractMultiLineBody(const std::vector<std::s
     return code;
 }
 
+// Splits "func ... { body }" into its declaration and statements, bodies can be inline or span lines
+std::vector<std::string> Compiler::functionBody(const std::vector<std::string>& lines, size_t funcLine, std::string& decl) {
+    const auto& funcDefLine = lines[funcLine];
+    size_t bracePos = funcDefLine.find('{');
+    size_t closeBrace = funcDefLine.rfind('}');
+
+    std::string parsedLine;
+    if (bracePos != std::string::npos) {
+        decl = funcDefLine.substr(0, bracePos);
+        if (closeBrace != std::string::npos && closeBrace > bracePos) {
+            parsedLine = funcDefLine.substr(bracePos + 1, closeBrace - bracePos - 1);
+        }
+    } else {
+        decl = funcDefLine;
+    }
+
+    if (trim(parsedLine).empty()) return extractMultiLineBody(lines, funcLine + 1);
+    return splitStatements(parsedLine);
+}
+
 // Parse function declaration to extract name, args, and return type
-FunctionDeclaration Compiler::parseFunctionDeclaration(const std::string& decl) {
+FunctionDeclaration Compiler::parseFunctionDeclaration(const std::string& decl, bool diagnose) {
     FunctionDeclaration result;
     
     auto tokens = tokenize(decl);
     if (tokens.size() < 2 || tokens[0] != "func") {
-        NCERROR("Invalid function definition");
+        if (diagnose) report("error", "Invalid function definition");
         result.valid = false;
         return result;
     }
@@ -102,7 +129,7 @@ FunctionDeclaration Compiler::parseFunctionDeclaration(const std::string& decl)
     size_t funcPos = decl.find("func");
     size_t parenOpen = decl.find("(", funcPos);
     if (parenOpen == std::string::npos) {
-        NCERROR("Missing opening parenthesis in function declaration");
+        if (diagnose) report("error", "Missing opening parenthesis in function declaration");
         result.valid = false;
         return result;
     }
@@ -112,7 +139,7 @@ FunctionDeclaration Compiler::parseFunctionDeclaration(const std::string& decl)
     // Extract arguments
     size_t parenClose = decl.find(")", parenOpen);
     if (parenClose == std::string::npos) {
-        NCERROR("Missing closing parenthesis in function declaration");
+        if (diagnose) report("error", "Missing closing parenthesis in function declaration");
         result.valid = false;
         return result;
     }
@@ -147,17 +174,538 @@ FunctionDeclaration Compiler::parseFunctionDeclaration(const std::string& decl)
     return result;
 }
 
+// Every scalar name of the language, only the sized ones can be vector elements (i32x4, not intx4)
+struct ScalarTypeName {
+    std::string_view name;
+    TypeName::Kind kind;
+    unsigned bits;
+    bool vectorElement;
+};
+
+static constexpr ScalarTypeName SCALAR_TYPES[] = {
+    {"int", TypeName::Kind::Integer, 64, false},
+    {"void", TypeName::Kind::Void, 0, false},
+    {"i8", TypeName::Kind::Integer, 8, true},
+    {"i16", TypeName::Kind::Integer, 16, true},
+    {"i32", TypeName::Kind::Integer, 32, true},
+    {"i64", TypeName::Kind::Integer, 64, true},
+    {"float", TypeName::Kind::Float, 32, false},
+    {"f32", TypeName::Kind::Float, 32, true},
+    {"double", TypeName::Kind::Float, 64, false},
+    {"f64", TypeName::Kind::Float, 64, true},
+};
+
+// Keeps a typo like i8x65536 from turning into a vector LLVM needs seconds for
+static constexpr unsigned MAX_VECTOR_LANES = 4096;
+
+static const ScalarTypeName* findScalarType(std::string_view name) {
+    for (const auto& scalar : SCALAR_TYPES) {
+        if (scalar.name == name) return &scalar;
+    }
+    return nullptr;
+}
+
+std::optional<TypeName> Compiler::parseTypeName(const std::string& name, std::string& error) {
+    if (const auto* scalar = findScalarType(name)) {
+        return TypeName{scalar->kind, scalar->bits};
+    }
+
+    // Vector types: <element>x<lanes>, e.g. f32x4, i32x8 or f32xN for the native register width
+    const size_t xPos = name.find('x');
+    if (xPos == std::string::npos || xPos + 1 >= name.size()) return std::nullopt;
+
+    const auto* element = findScalarType(std::string_view(name).substr(0, xPos));
+    if (element == nullptr || !element->vectorElement) return std::nullopt;
+
+    TypeName type{element->kind, element->bits};
+    const std::string_view lanes = std::string_view(name).substr(xPos + 1);
+    if (lanes == "N") {
+        type.nativeLanes = true;
+        return type;
+    }
+
+    // Signs, trailing garbage and counts that do not fit are all malformed
+    const auto [ptr, ec] = std::from_chars(lanes.data(), lanes.data() + lanes.size(), type.lanes);
+    if (ec != std::errc() || ptr != lanes.data() + lanes.size()) {
+        error = fmt::format("Invalid vector lane count: {}", name);
+        return std::nullopt;
+    }
+    if (type.lanes == 0 || (type.lanes & (type.lanes - 1)) != 0 || type.lanes > MAX_VECTOR_LANES) {
+        error = fmt::format("Vector lane count must be a power of two up to {}: {}", MAX_VECTOR_LANES, name);
+        return std::nullopt;
+    }
+    return type;
+}
+
 // Convert Nova type to LLVM type
 llvm::Type* Compiler::novaTypeToLLVM(const std::string& novaType, llvm::LLVMContext& ctx) {
-    if (novaType == "int") return llvm::Type::getInt64Ty(ctx);
-    if (novaType == "void") return llvm::Type::getVoidTy(ctx);
-    if (novaType == "i8") return llvm::Type::getInt8Ty(ctx);
-    if (novaType == "i16") return llvm::Type::getInt16Ty(ctx);
-    if (novaType == "i32") return llvm::Type::getInt32Ty(ctx);
-    if (novaType == "i64") return llvm::Type::getInt64Ty(ctx);
-    if (novaType == "float") return llvm::Type::getFloatTy(ctx);
-    if (novaType == "double") return llvm::Type::getDoubleTy(ctx);
-    return nullptr; // Unknown type
+    std::string error;
+    const auto type = parseTypeName(novaType, error);
+    if (!error.empty()) report("error", error);
+    if (!type) return nullptr; // Unknown type
+
+    llvm::Type* element = nullptr;
+    switch (type->kind) {
+        case TypeName::Kind::Void: return llvm::Type::getVoidTy(ctx);
+        case TypeName::Kind::Integer: element = llvm::Type::getIntNTy(ctx, type->bits); break;
+        case TypeName::Kind::Float: element = type->bits == 32 ? llvm::Type::getFloatTy(ctx) : llvm::Type::getDoubleTy(ctx); break;
+    }
+    if (type->lanes == 0 && !type->nativeLanes) return element;
+
+    const unsigned lanes = type->nativeLanes ? std::max(1u, nativeVectorBits() / type->bits) : type->lanes;
+
+    // Once per type, every use of it resolves the type again
+    if (static_cast<uint64_t>(lanes) * type->bits > nativeVectorBits() && _wideVectorWarnings.insert(novaType).second) {
+        report("warning", fmt::format("{} is wider than the {}-bit vector registers of the target, it will be split", novaType, nativeVectorBits()));
+    }
+    return llvm::FixedVectorType::get(element, lanes);
+}
+
+// Width of the target's vector registers, asked from the target so it follows --cpu/--features
+unsigned Compiler::nativeVectorBits() {
+    if (_nativeVectorBits != 0) return _nativeVectorBits;
+    _nativeVectorBits = 128;
+
+    auto* machine = targetMachine();
+    if (machine == nullptr) return _nativeVectorBits;
+
+    // TTI works per function since subtargets come from function attributes
+    llvm::Module probeModule("vector-width", llvmContext());
+    auto* probe = llvm::Function::Create(
+        llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext()), false),
+        llvm::Function::ExternalLinkage,
+        "probe",
+        probeModule
+    );
+    if (!machine->getTargetCPU().empty()) probe->addFnAttr("target-cpu", machine->getTargetCPU());
+    if (!machine->getTargetFeatureString().empty()) probe->addFnAttr("target-features", machine->getTargetFeatureString());
+
+    const auto tti = machine->getTargetTransformInfo(*probe);
+    const auto bits = tti.getRegisterBitWidth(llvm::TargetTransformInfo::RGK_FixedWidthVector).getFixedValue();
+    if (bits != 0) _nativeVectorBits = bits;
+    return _nativeVectorBits;
+}
+
+// Convert a value to the given type, scalars are broadcast when the target is a vector
+llvm::Value* Compiler::coerceValue(llvm::IRBuilder<>& builder, llvm::Value* value, llvm::Type* type) {
+    llvm::Type* from = value->getType();
+    if (from == type) return value;
+
+    if (auto* vectorType = llvm::dyn_cast<llvm::FixedVectorType>(type)) {
+        if (from->isVectorTy()) return nullptr;
+        llvm::Value* element = coerceValue(builder, value, vectorType->getElementType());
+        if (element == nullptr) return nullptr;
+        return builder.CreateVectorSplat(vectorType->getNumElements(), element);
+    }
+
+    if (from->isIntegerTy() && type->isIntegerTy()) return builder.CreateIntCast(value, type, true);
+    if (from->isIntegerTy() && type->isFloatingPointTy()) return builder.CreateSIToFP(value, type);
+    if (from->isFloatingPointTy() && type->isIntegerTy()) return builder.CreateFPToSI(value, type);
+    if (from->isFloatingPointTy() && type->isFloatingPointTy()) return builder.CreateFPCast(value, type);
+    return nullptr;
+}
+
+// Lower + - * / for scalars and vectors alike, vector operands map to single vector instructions
+llvm::Value* Compiler::emitArithmetic(llvm::IRBuilder<>& builder, TokenType op, llvm::Value* lhs, llvm::Value* rhs) {
+    if (lhs->getType()->isVectorTy() && !rhs->getType()->isVectorTy()) {
+        rhs = coerceValue(builder, rhs, lhs->getType());
+    }else if (rhs->getType()->isVectorTy() && !lhs->getType()->isVectorTy()) {
+        lhs = coerceValue(builder, lhs, rhs->getType());
+    }else if (lhs->getType() != rhs->getType()) {
+        // Literals take the type of the other operand unless that would drop a fraction,
+        // other mixed scalars promote to floating point, otherwise to the wider integer
+        llvm::Type* lt = lhs->getType();
+        llvm::Type* rt = rhs->getType();
+        llvm::Type* common = lt;
+        if (llvm::isa<llvm::Constant>(rhs) && !(rt->isFloatingPointTy() && lt->isIntegerTy())) {
+            common = lt;
+        }else if (llvm::isa<llvm::Constant>(lhs) && !(lt->isFloatingPointTy() && rt->isIntegerTy())) {
+            common = rt;
+        }else if (rt->isFloatingPointTy() && (!lt->isFloatingPointTy() || rt->getPrimitiveSizeInBits() > lt->getPrimitiveSizeInBits())) {
+            common = rt;
+        }else if (lt->isIntegerTy() && rt->isIntegerTy() && rt->getPrimitiveSizeInBits() > lt->getPrimitiveSizeInBits()) {
+            common = rt;
+        }
+        lhs = coerceValue(builder, lhs, common);
+        rhs = coerceValue(builder, rhs, common);
+    }
+    if (lhs == nullptr || rhs == nullptr || lhs->getType() != rhs->getType()) return nullptr;
+
+    const bool fp = lhs->getType()->isFPOrFPVectorTy();
+    switch (op) {
+        case TokenType::Plus:  return fp ? builder.CreateFAdd(lhs, rhs) : builder.CreateAdd(lhs, rhs);
+        case TokenType::Minus: return fp ? builder.CreateFSub(lhs, rhs) : builder.CreateSub(lhs, rhs);
+        case TokenType::Star:  return fp ? builder.CreateFMul(lhs, rhs) : builder.CreateMul(lhs, rhs);
+        case TokenType::Slash: return fp ? builder.CreateFDiv(lhs, rhs) : builder.CreateSDiv(lhs, rhs);
+        default: return nullptr;
+    }
+}
+
+// Binding strength of binary operators, -1 ends the expression
+static int precedence(TokenType type) {
+    switch (type) {
+        case TokenType::Assign: return 1;
+        case TokenType::Plus:
+        case TokenType::Minus:  return 2;
+        case TokenType::Star:
+        case TokenType::Slash:  return 3;
+        default: return -1;
+    }
+}
+
+// Integer literals stay int64, anything with a '.' or exponent is a double
+static bool parseNumber(const std::string& text, bool& isFloat, int64_t& intValue, double& floatValue) {
+    isFloat = text.find_first_of(".eE") != std::string::npos;
+    const char* begin = text.data();
+    const char* end = text.data() + text.size();
+    if (isFloat) {
+        char* parsedEnd = nullptr;
+        floatValue = std::strtod(begin, &parsedEnd);
+        return parsedEnd == end;
+    }
+    const auto result = std::from_chars(begin, end, intValue);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// Turns one tokenized statement into a Statement, error is set when it returns false
+bool Compiler::parseStatement(const Assignment& assignment, Statement& statement, std::string& error) {
+    const auto& tokens = assignment.tokens;
+    size_t pos = 0;
+
+    if (tokens[0].token == "ret") {
+        statement.kind = StatementKind::Return;
+        pos = 1;
+        if (pos == tokens.size()) return true;
+    }else if (tokens[0].token == "var" || tokens[0].token == "const") {
+        statement.kind = StatementKind::Declare;
+        statement.constant = tokens[0].token == "const";
+
+        // var name = ... or var type name = ...
+        if (tokens.size() > 2 && tokens[2].type == TokenType::Assign) {
+            statement.name = tokens[1].token;
+            pos = 3;
+        }else if (tokens.size() > 3 && tokens[3].type == TokenType::Assign) {
+            statement.type = tokens[1].token;
+            statement.name = tokens[2].token;
+            pos = 4;
+        }else {
+            error = "Expected 'var [type] name = value'";
+            return false;
+        }
+        if (tokens[pos - 2].type != TokenType::Identifier) {
+            error = fmt::format("'{}' is not a valid variable name", tokens[pos - 2].token);
+            return false;
+        }
+    }else {
+        statement.kind = StatementKind::Expression;
+    }
+
+    if (pos == tokens.size()) {
+        error = "Expected an expression";
+        return false;
+    }
+
+    auto value = parseExpression(tokens, pos, 0, error);
+    if (!value) return false;
+    if (pos != tokens.size()) {
+        error = fmt::format("Unexpected token '{}'", tokens[pos].token);
+        return false;
+    }
+
+    foldConstants(*value);
+    statement.value = std::move(value);
+    return true;
+}
+
+// Precedence climbing, '=' is right associative and binds weakest
+std::optional<Expr> Compiler::parseExpression(const std::vector<Token>& tokens, size_t& pos, int minPrecedence, std::string& error) {
+    auto lhs = parsePrimary(tokens, pos, error);
+    if (!lhs) return std::nullopt;
+
+    while (pos < tokens.size()) {
+        const TokenType op = tokens[pos].type;
+        const int prec = precedence(op);
+        if (prec < 0 || prec < minPrecedence) break;
+        pos++;
+
+        auto rhs = parseExpression(tokens, pos, op == TokenType::Assign ? prec : prec + 1, error);
+        if (!rhs) return std::nullopt;
+
+        if (op == TokenType::Assign) {
+            if (lhs->kind != ExprKind::Variable) {
+                error = "Left side of '=' must be a variable";
+                return std::nullopt;
+            }
+            lhs = Expr{.kind = ExprKind::Assign, .value = lhs->value, .operands = {std::move(*rhs)}};
+        }else {
+            Expr binary{.kind = ExprKind::Binary, .op = op};
+            binary.operands.push_back(std::move(*lhs));
+            binary.operands.push_back(std::move(*rhs));
+            lhs = std::move(binary);
+        }
+    }
+
+    return lhs;
+}
+
+std::optional<Expr> Compiler::parsePrimary(const std::vector<Token>& tokens, size_t& pos, std::string& error) {
+    if (pos >= tokens.size()) {
+        error = "Unexpected end of expression";
+        return std::nullopt;
+    }
+
+    const Token& token = tokens[pos++];
+    switch (token.type) {
+        case TokenType::Number:
+            return Expr{.kind = ExprKind::Number, .value = token.token};
+
+        case TokenType::Minus: {
+            auto operand = parsePrimary(tokens, pos, error);
+            if (!operand) return std::nullopt;
+            Expr negate{.kind = ExprKind::Negate};
+            negate.operands.push_back(std::move(*operand));
+            return negate;
+        }
+
+        case TokenType::LParen: {
+            auto inner = parseExpression(tokens, pos, 0, error);
+            if (!inner) return std::nullopt;
+            if (pos >= tokens.size() || tokens[pos].type != TokenType::RParen) {
+                error = "Expected ')'";
+                return std::nullopt;
+            }
+            pos++;
+            return inner;
+        }
+
+        case TokenType::Identifier: {
+            if (pos >= tokens.size() || tokens[pos].type != TokenType::LParen) {
+                return Expr{.kind = ExprKind::Variable, .value = token.token};
+            }
+
+            // Function call
+            pos++;
+            Expr call{.kind = ExprKind::Call, .value = token.token};
+            if (pos < tokens.size() && tokens[pos].type == TokenType::RParen) {
+                pos++;
+                return call;
+            }
+            while (true) {
+                auto arg = parseExpression(tokens, pos, precedence(TokenType::Assign) + 1, error);
+                if (!arg) return std::nullopt;
+                call.operands.push_back(std::move(*arg));
+
+                if (pos < tokens.size() && tokens[pos].type == TokenType::Comma) {
+                    pos++;
+                }else if (pos < tokens.size() && tokens[pos].type == TokenType::RParen) {
+                    pos++;
+                    return call;
+                }else {
+                    error = fmt::format("Expected ',' or ')' in call to {}", token.token);
+                    return std::nullopt;
+                }
+            }
+        }
+
+        default:
+            error = fmt::format("Unexpected token '{}'", token.token);
+            return std::nullopt;
+    }
+}
+
+// Evaluates literal subexpressions at parse time so LLVM never sees them
+void Compiler::foldConstants(Expr& expr) {
+    for (auto& operand : expr.operands) foldConstants(operand);
+
+    if (expr.kind == ExprKind::Negate && expr.operands[0].kind == ExprKind::Number) {
+        const std::string& text = expr.operands[0].value;
+        std::string folded = text[0] == '-' ? text.substr(1) : "-" + text;
+        expr = Expr{.kind = ExprKind::Number, .value = std::move(folded)};
+        return;
+    }
+
+    if (expr.kind != ExprKind::Binary ||
+        expr.operands[0].kind != ExprKind::Number || expr.operands[1].kind != ExprKind::Number) {
+        return;
+    }
+
+    bool lhsFloat = false, rhsFloat = false;
+    int64_t lhsInt = 0, rhsInt = 0;
+    double lhsFp = 0.0, rhsFp = 0.0;
+    if (!parseNumber(expr.operands[0].value, lhsFloat, lhsInt, lhsFp) ||
+        !parseNumber(expr.operands[1].value, rhsFloat, rhsInt, rhsFp)) {
+        return;
+    }
+
+    if (lhsFloat || rhsFloat) {
+        const double a = lhsFloat ? lhsFp : static_cast<double>(lhsInt);
+        const double b = rhsFloat ? rhsFp : static_cast<double>(rhsInt);
+        double result = 0.0;
+        switch (expr.op) {
+            case TokenType::Plus:  result = a + b; break;
+            case TokenType::Minus: result = a - b; break;
+            case TokenType::Star:  result = a * b; break;
+            case TokenType::Slash: result = a / b; break;
+            default: return;
+        }
+        if (!std::isfinite(result)) return;
+
+        // Keep the literal a double even when the result is whole
+        std::string text = fmt::format("{}", result);
+        if (text.find_first_of(".eE") == std::string::npos) text += ".0";
+        expr = Expr{.kind = ExprKind::Number, .value = std::move(text)};
+        return;
+    }
+
+    int64_t result = 0;
+    switch (expr.op) {
+        case TokenType::Plus:  if (__builtin_add_overflow(lhsInt, rhsInt, &result)) return; break;
+        case TokenType::Minus: if (__builtin_sub_overflow(lhsInt, rhsInt, &result)) return; break;
+        case TokenType::Star:  if (__builtin_mul_overflow(lhsInt, rhsInt, &result)) return; break;
+        case TokenType::Slash:
+            // Division by zero and INT64_MIN / -1 are left to run time
+            if (rhsInt == 0 || (lhsInt == INT64_MIN && rhsInt == -1)) return;
+            result = lhsInt / rhsInt;
+            break;
+        default: return;
+    }
+    expr = Expr{.kind = ExprKind::Number, .value = std::to_string(result)};
+}
+
+// Emits an expression, locals map names directly to SSA values so no allocas are needed
+llvm::Value* Compiler::emitExpression(
+    llvm::IRBuilder<>& builder,
+    const Expr& expr,
+    std::unordered_map<std::string, llvm::Value*>& locals,
+    const std::unordered_set<std::string>& constants,
+    std::string& error
+) {
+    switch (expr.kind) {
+        case ExprKind::Number: {
+            bool isFloat = false;
+            int64_t intValue = 0;
+            double floatValue = 0.0;
+            if (!parseNumber(expr.value, isFloat, intValue, floatValue)) {
+                error = fmt::format("Invalid number '{}'", expr.value);
+                return nullptr;
+            }
+            if (isFloat) return llvm::ConstantFP::get(builder.getDoubleTy(), floatValue);
+            return llvm::ConstantInt::get(builder.getInt64Ty(), intValue, true);
+        }
+
+        case ExprKind::Variable: {
+            const auto local = locals.find(expr.value);
+            if (local == locals.end()) {
+                error = fmt::format("Unknown variable '{}'", expr.value);
+                return nullptr;
+            }
+            return local->second;
+        }
+
+        case ExprKind::Negate: {
+            llvm::Value* operand = emitExpression(builder, expr.operands[0], locals, constants, error);
+            if (operand == nullptr) return nullptr;
+            return operand->getType()->isFPOrFPVectorTy() ? builder.CreateFNeg(operand) : builder.CreateNeg(operand);
+        }
+
+        case ExprKind::Binary: {
+            llvm::Value* lhs = emitExpression(builder, expr.operands[0], locals, constants, error);
+            if (lhs == nullptr) return nullptr;
+            llvm::Value* rhs = emitExpression(builder, expr.operands[1], locals, constants, error);
+            if (rhs == nullptr) return nullptr;
+
+            llvm::Value* result = emitArithmetic(builder, expr.op, lhs, rhs);
+            if (result == nullptr) error = "Operands have incompatible types";
+            return result;
+        }
+
+        case ExprKind::Assign: {
+            const auto local = locals.find(expr.value);
+            if (local == locals.end()) {
+                error = fmt::format("Assignment to undeclared variable '{}'", expr.value);
+                return nullptr;
+            }
+            // Checked here and not per statement, assignments nest: x = c = 3, f(c = 2)
+            if (constants.contains(expr.value)) {
+                error = fmt::format("Can not assign to constant '{}'", expr.value);
+                return nullptr;
+            }
+            llvm::Value* value = emitExpression(builder, expr.operands[0], locals, constants, error);
+            if (value == nullptr) return nullptr;
+
+            // Assignments keep the variable's type and just rebind the name to the new SSA value
+            value = coerceValue(builder, value, local->second->getType());
+            if (value == nullptr) {
+                error = fmt::format("Can not assign to '{}', incompatible type", expr.value);
+                return nullptr;
+            }
+            local->second = value;
+            return value;
+        }
+
+        case ExprKind::Call: {
+            llvm::Module* module = builder.GetInsertBlock()->getModule();
+            llvm::Function* callee = module->getFunction(expr.value);
+            if (callee == nullptr) {
+                const auto decl = lookupDeclaration(expr.value);
+                if (!decl) {
+                    error = fmt::format("Unknown function '{}'", expr.value);
+                    return nullptr;
+                }
+                callee = declareFunction(module, *decl);
+                if (callee == nullptr) return nullptr;
+            }
+
+            if (callee->arg_size() != expr.operands.size()) {
+                error = fmt::format("{} expects {} arguments, got {}", expr.value, callee->arg_size(), expr.operands.size());
+                return nullptr;
+            }
+
+            std::vector<llvm::Value*> args;
+            for (size_t i = 0; i < expr.operands.size(); i++) {
+                llvm::Value* arg = emitExpression(builder, expr.operands[i], locals, constants, error);
+                if (arg == nullptr) return nullptr;
+                arg = coerceValue(builder, arg, callee->getArg(i)->getType());
+                if (arg == nullptr) {
+                    error = fmt::format("Argument {} of {} has an incompatible type", i + 1, expr.value);
+                    return nullptr;
+                }
+                args.push_back(arg);
+            }
+            // Callees can be fastcc after linkage inference, a call with another convention is UB
+            auto* call = builder.CreateCall(callee, args);
+            call->setCallingConv(callee->getCallingConv());
+            return call;
+        }
+    }
+
+    return nullptr;
+}
+
+void Compiler::report(std::string_view severity, const std::string& funcName, size_t funcLine, const std::string& message) {
+    if (_diagnostics) {
+        std::string snippet;
+        if (_sourceLines && funcLine < _sourceLines->size()) snippet = (*_sourceLines)[funcLine];
+        _diagnostics->push_back(ParseError{funcLine + 1, 0, message, std::string(severity), _diagnosticFile, snippet});
+        return;
+    }
+
+    if (severity == "error") _nceror(); else _ncwarn();
+    *logStream << termcolor::grey << termcolor::bold
+              << fmt::format("      [func {}:{}] ", funcName, funcLine + 1)
+              << termcolor::reset
+              << message
+              << std::endl;
+}
+
+// Problems outside of a function body, e.g. a malformed declaration or type
+void Compiler::report(std::string_view severity, const std::string& message) {
+    if (_diagnostics) {
+        _diagnostics->push_back(ParseError{0, 0, message, std::string(severity), _diagnosticFile, ""});
+        return;
+    }
+
+    if (severity == "error") NCERROR("{}", message); else NCWARN("{}", message);
 }
 
 // Generate LLVM IR for function body
@@ -181,74 +729,99 @@ void Compiler::generateFunctionBody(
         std::vector<Assignment> lineAssignments = splitCall(line);
         assignments.insert(assignments.end(), lineAssignments.begin(), lineAssignments.end());
     }
+
+    std::unordered_map<std::string, llvm::Value*> locals;
+    std::unordered_set<std::string> constants;
+    for (auto& arg : function->args()) {
+        locals[arg.getName().str()] = &arg;
+    }
     
-    for (const auto& Token : assignments) {
-        
-        for (const auto& token : Token.tokens) {
+    for (const auto& assignment : assignments) {
+        // Braces of the body itself
+        if (assignment.tokens.empty() ||
+            assignment.tokens[0].type == TokenType::LBrace || assignment.tokens[0].type == TokenType::RBrace) {
+            continue;
+        }
 
-            
+        if (hasReturn) {
+            report("warning", funcName, funcLine, "Code after 'ret' is never executed");
+            break;
+        }
 
-        };
+        Statement statement;
+        std::string error;
+        if (!parseStatement(assignment, statement, error)) {
+            report("error", funcName, funcLine, error);
+            break;
+        }
 
-        // Parse function call
+        if (statement.kind == StatementKind::Return) {
+            if (!statement.value) {
+                if (!returnType->isVoidTy()) {
+                    report("error", funcName, funcLine, "'ret' without a value in a function returning a value");
+                    break;
+                }
+                builder.CreateRetVoid();
+                hasReturn = true;
+                continue;
+            }
 
-        
-        // Skip closing braces
-        
-        // std::vector<std::string> line = splitCall(Iline);
-        // auto closeBracket = std::find(line.begin(), line.end(), "{");
+            llvm::Value* value = emitExpression(builder, *statement.value, locals, constants, error);
+            if (value != nullptr && !returnType->isVoidTy()) value = coerceValue(builder, value, returnType);
+            if (value == nullptr || returnType->isVoidTy()) {
+                report("error", funcName, funcLine, error.empty() ? "Return value does not match the return type" : error);
+                break;
+            }
+            builder.CreateRet(value);
+            hasReturn = true;
+            continue;
+        }
 
-        // if (closeBracket != line.end()) {
-        //    std::size_t index = std::distance(line.begin(), closeBracket);
-            
-        // }
-        
-        // Parse return statement
-        // if (line.find("ret") != std::string::npos) {
-        //     size_t retPos = line.find("ret");
-        //     std::string retValue = trim(line.substr(retPos + 3));
-            
-        //     if (returnType->isIntegerTy()) {
-        //         int64_t value = 0;
-        //         if (!retValue.empty()) {
-        //             value = std::stoll(retValue);
-        //         }
-        //         builder.CreateRet(llvm::ConstantInt::get(returnType, value));
-        //     } else if (returnType->isVoidTy()) {
-        //         builder.CreateRetVoid();
-        //     } else if (returnType->isFloatingPointTy()) {
-        //         double value = 0.0;
-        //         if (!retValue.empty()) {
-        //             value = std::stod(retValue);
-        //         }
-        //         builder.CreateRet(llvm::ConstantFP::get(returnType, value));
-        //     }
-            
-        //     hasReturn = true;
-        // }
+        if (statement.kind == StatementKind::Declare) {
+            if (locals.contains(statement.name)) {
+                report("error", funcName, funcLine, fmt::format("'{}' is already declared", statement.name));
+                break;
+            }
+
+            llvm::Value* value = emitExpression(builder, *statement.value, locals, constants, error);
+            if (value != nullptr && !statement.type.empty()) {
+                llvm::Type* type = novaTypeToLLVM(statement.type, ctx);
+                if (type == nullptr || type->isVoidTy()) {
+                    report("error", funcName, funcLine, fmt::format("Unknown type '{}'", statement.type));
+                    break;
+                }
+                value = coerceValue(builder, value, type);
+                if (value == nullptr) error = fmt::format("Value does not fit type '{}'", statement.type);
+            }
+            if (value == nullptr) {
+                report("error", funcName, funcLine, error);
+                break;
+            }
+
+            if (auto* inst = llvm::dyn_cast<llvm::Instruction>(value); inst && !inst->hasName()) {
+                inst->setName(statement.name);
+            }
+            locals[statement.name] = value;
+            if (statement.constant) constants.insert(statement.name);
+            continue;
+        }
+
+        if (emitExpression(builder, *statement.value, locals, constants, error) == nullptr) {
+            report("error", funcName, funcLine, error);
+            break;
+        }
     }
     
     // Add default return if missing
     if (!hasReturn) {
-        _ncwarn();
-        std::cout << termcolor::grey << termcolor::bold 
-                  << fmt::format("      [func {}:{}] ", funcName, funcLine + 1) 
-                  << termcolor::reset 
-                  << "Function has no return statement (default 'int' has been written)" 
-                  << std::endl;
+        report("warning", funcName, funcLine, "Function has no return statement (default 'int' has been written)");
         
         if (returnType->isVoidTy()) {
             builder.CreateRetVoid();
-        } else if (returnType->isIntegerTy()) {
-            builder.CreateRet(llvm::ConstantInt::get(returnType, 0));
-        } else if (returnType->isFloatingPointTy()) {
-            builder.CreateRet(llvm::ConstantFP::get(returnType, 0.0));
+        } else {
+            builder.CreateRet(llvm::Constant::getNullValue(returnType));
         }
     }
-
-    
-
-
 }
 
 
@@ -0,0 +1,116 @@
+#include "compiler.h"
+#include "logger.h"
+#include "query.h"
+#include <fstream>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/raw_ostream.h>
+#include <unistd.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace Nova::Compiler {
+
+// Even without hitting the budget the context is renewed this often, types and
+// constants interned by old builds are never freed otherwise
+static constexpr size_t CONTEXT_GENERATIONS = 64;
+
+static size_t heapInUse() {
+#if defined(__GLIBC__)
+    const auto info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static size_t residentMemory() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) return 0;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+static double toMB(size_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+// Called before every build, decides whether the context survives into this generation
+void Compiler::beginGeneration() {
+    _generation++;
+
+    // Nothing outlives a non-incremental build, every build gets a fresh context
+    if (!_options.incremental) {
+        _contextGeneration++;
+        _moduleCache.clear();
+        if (_contextGeneration > 1) recycleContext();
+        return;
+    }
+
+    checkMemory();
+}
+
+// Signatures resolved by queries intern types too, so edits age the context like builds do
+void Compiler::checkMemory() {
+    _contextGeneration++;
+
+    const size_t budgetMB = _options.memoryBudgetMB.value_or(_configMemoryBudgetMB);
+    const bool overBudget = budgetMB != 0 && heapInUse() > budgetMB * 1024 * 1024;
+    if (overBudget || _contextGeneration > CONTEXT_GENERATIONS) {
+        recycleContext();
+    }
+}
+
+// Cached modules are parked as bitcode, the context with everything it interned is
+// destroyed and modules come back lazily into a fresh one when their file is built.
+// Modules returned by compile() share ownership of the old context and stay valid
+void Compiler::recycleContext() {
+    const size_t before = heapInUse();
+
+    for (auto& [file, cache] : _moduleCache) {
+        if (!cache.module) continue;
+
+        cache.bitcode.clear();
+        llvm::raw_string_ostream out(cache.bitcode);
+        llvm::WriteBitcodeToFile(*cache.module, out);
+        out.flush();
+        cache.module.reset();
+    }
+
+    context.reset(); // The next module to come back creates a fresh one
+    _contextGeneration = 1;
+    if (_queries) _queries->invalidateTypes();
+
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+
+    NCINFO("Recycled LLVM context: heap {:.1f} MB -> {:.1f} MB", toMB(before), toMB(heapInUse()));
+}
+
+void Compiler::reportMemoryUsage() const {
+    size_t liveModules = 0, parkedModules = 0, parkedBytes = 0;
+    size_t functions = 0, instructions = 0;
+    for (const auto& [file, cache] : _moduleCache) {
+        if (cache.module) {
+            liveModules++;
+            for (const auto& function : *cache.module) {
+                functions++;
+                instructions += function.getInstructionCount();
+            }
+        }else if (!cache.bitcode.empty()) {
+            parkedModules++;
+            parkedBytes += cache.bitcode.size();
+        }
+    }
+
+    const size_t budgetMB = _options.memoryBudgetMB.value_or(_configMemoryBudgetMB);
+    NCINFO("◁ ─┬─Memory───▷");
+    NCINFO("  ├▶ Builds: {} (context age: {}/{})", _generation, _contextGeneration, CONTEXT_GENERATIONS);
+    NCINFO("  ├▶ Modules: {} live ({} functions, {} instructions), {} parked ({:.1f} MB bitcode)",
+           liveModules, functions, instructions, parkedModules, toMB(parkedBytes));
+    NCINFO("  ├▶ Heap: {:.1f} MB{}", toMB(heapInUse()), budgetMB ? fmt::format(" (budget {} MB)", budgetMB) : "");
+    NCINFO("  └▶ Resident: {:.1f} MB", toMB(residentMemory()));
+}
+
+} // namespace Nova::Compiler
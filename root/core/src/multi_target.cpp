@@ -0,0 +1,75 @@
+#include "compiler.h"
+#include "logger.h"
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <thread>
+
+namespace Nova::Compiler {
+
+// Points a module generated for another target at this compiler's target. Nova IR has no
+// pointer sized or ABI dependent types, only the vector widths of 'xN' types stay those of the frontend target.
+// The frontend leaves these modules unoptimized, emitProject optimizes a copy with this target's TTI
+void Compiler::retarget(llvm::Module& module) {
+    auto* machine = targetMachine();
+    if (!machine) return;
+
+    module.setTargetTriple(machine->getTargetTriple());
+    module.setDataLayout(machine->createDataLayout());
+    for (auto& function : module) {
+        if (function.isIntrinsic()) continue;
+        function.removeFnAttr("target-cpu");
+        function.removeFnAttr("target-features");
+        if (!machine->getTargetCPU().empty()) function.addFnAttr("target-cpu", machine->getTargetCPU());
+        if (!machine->getTargetFeatureString().empty()) function.addFnAttr("target-features", machine->getTargetFeatureString());
+    }
+}
+
+// Every target gets its own compiler, context and target machine, so optimization and emission run
+// in parallel. The frontend modules reach them as bitcode, a context can not be shared between threads
+void Compiler::emitForTargets(const Project& project, const std::vector<llvm::Module*>& modules, const std::filesystem::path& outDir) {
+    std::vector<std::string> bitcode;
+    for (const auto* module : modules) {
+        std::string buffer;
+        llvm::raw_string_ostream out(buffer);
+        llvm::WriteBitcodeToFile(*module, out);
+        out.flush();
+        bitcode.push_back(std::move(buffer));
+    }
+
+    std::vector<std::thread> threads;
+    for (const auto& target : _configTargets) {
+        threads.emplace_back([this, &project, &bitcode, &outDir, target]() {
+            BuildOptions options = _options;
+            options.target = target;
+            options.incremental = false; // Backends own their modules, nothing is cached per target
+            Compiler backend(options);
+            backend._declarations = _declarations;
+
+            std::vector<std::unique_ptr<llvm::Module>> owned;
+            std::vector<llvm::Module*> targetModules;
+            for (const auto& code : bitcode) {
+                auto module = llvm::parseBitcodeFile(llvm::MemoryBufferRef(code, project.name), backend.llvmContext());
+                if (!module) {
+                    NERROR("  Failed to load module for {}: {}", target.triple, llvm::toString(module.takeError()));
+                    return;
+                }
+                (*module)->setModuleIdentifier(project.name);
+                backend.retarget(**module);
+                targetModules.push_back(module->get());
+                owned.push_back(std::move(*module));
+            }
+
+            const auto targetDir = outDir / backend.resolveTarget().triple;
+            std::error_code ec;
+            std::filesystem::create_directories(targetDir, ec);
+            backend.emitProject(project, targetModules, targetDir);
+            backend._writer.flush();
+            NCINFO("  ├▶ {} done", targetDir.filename().string());
+        });
+    }
+    for (auto& thread : threads) thread.join();
+}
+
+} // namespace Nova::Compiler
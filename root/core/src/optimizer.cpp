@@ -0,0 +1,162 @@
+#include "compiler.h"
+#include "logger.h"
+#include <filesystem>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/ModuleSummaryIndex.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace Nova::Compiler {
+
+// Projects with more files than this are built with ThinLTO when lto = "auto"
+static constexpr size_t AUTO_THIN_LTO_FILES = 64;
+
+static llvm::OptimizationLevel toOptimizationLevel(unsigned level) {
+    switch (level) {
+        case 0: return llvm::OptimizationLevel::O0;
+        case 1: return llvm::OptimizationLevel::O1;
+        case 2: return llvm::OptimizationLevel::O2;
+        default: return llvm::OptimizationLevel::O3;
+    }
+}
+
+// Command line wins over nc.conf, Auto gets resolved by project size
+LTOMode Compiler::resolveLTOMode(const Project& project) const {
+    LTOMode mode = _options.lto.value_or(project.lto.value_or(LTOMode::None));
+    if (mode == LTOMode::Auto) {
+        mode = project.files.size() > AUTO_THIN_LTO_FILES ? LTOMode::Thin : LTOMode::Full;
+    }
+    // A single file has nothing to link with
+    if (mode == LTOMode::Full && project.files.size() < 2) {
+        return LTOMode::None;
+    }
+    return mode;
+}
+
+// Merge every per-file module of a project into a single module so calls
+// between files can be inlined and specialized
+std::unique_ptr<llvm::Module> Compiler::linkProject(const Project& project, std::vector<std::unique_ptr<llvm::Module>> modules) {
+    if (modules.empty()) return nullptr;
+
+    auto linked = std::make_unique<llvm::Module>(project.name, llvmContext());
+    linked->setTargetTriple(modules.front()->getTargetTriple());
+    linked->setDataLayout(modules.front()->getDataLayout());
+    linked->setSourceFileName(project.name);
+
+    llvm::Linker linker(*linked);
+    for (auto& module : modules) {
+        const auto name = module->getSourceFileName();
+        if (linker.linkInModule(std::move(module))) {
+            NERROR("  Failed to link {} into {}", name, project.name);
+            return nullptr;
+        }
+    }
+
+    if (llvm::verifyModule(*linked, &llvm::errs())) {
+        NERROR("  Linked module verification failed");
+        return nullptr;
+    }
+
+    NCINFO("   ├─➤ Linked {} modules", project.files.size());
+    return linked;
+}
+
+// Instrumentation (--profile-generate) or profile use (--profile-use) for the module pipelines
+std::optional<llvm::PGOOptions> Compiler::pgoOptions() const {
+    auto fs = llvm::vfs::getRealFileSystem();
+    if (!_options.profileGenerate.empty()) {
+        return llvm::PGOOptions(_options.profileGenerate, "", "", "", fs, llvm::PGOOptions::IRInstr);
+    }
+    if (!_options.profileUse.empty()) {
+        if (!std::filesystem::exists(_options.profileUse)) {
+            NERROR("Profile not found: {} - building without it", _options.profileUse);
+            return std::nullopt;
+        }
+        return llvm::PGOOptions(_options.profileUse, "", "", "", fs, llvm::PGOOptions::IRUse);
+    }
+    return std::nullopt;
+}
+
+void Compiler::optimizeModule(llvm::Module& module, llvm::ThinOrFullLTOPhase phase) {
+    unsigned optLevel = _options.optLevel;
+    // LTO without optimization would only link and -O0 ignores profiles, so default to -O2
+    if ((phase != llvm::ThinOrFullLTOPhase::None || !_options.profileUse.empty()) && optLevel == 0) {
+        optLevel = 2;
+    }
+    const auto level = toOptimizationLevel(optLevel);
+
+    llvm::LoopAnalysisManager LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager CGAM;
+    llvm::ModuleAnalysisManager MAM;
+
+    llvm::PassBuilder PB(targetMachine(), llvm::PipelineTuningOptions(), pgoOptions());
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    llvm::ModulePassManager MPM;
+    if (level == llvm::OptimizationLevel::O0) {
+        MPM = PB.buildO0DefaultPipeline(level, phase);
+    }else if (phase == llvm::ThinOrFullLTOPhase::FullLTOPreLink) {
+        MPM = PB.buildLTOPreLinkDefaultPipeline(level);
+    }else if (phase == llvm::ThinOrFullLTOPhase::FullLTOPostLink) {
+        MPM = PB.buildLTODefaultPipeline(level, nullptr);
+    }else if (phase == llvm::ThinOrFullLTOPhase::ThinLTOPreLink) {
+        MPM = PB.buildThinLTOPreLinkDefaultPipeline(level);
+    }else {
+        MPM = PB.buildPerModuleDefaultPipeline(level);
+    }
+
+    MPM.run(module, MAM);
+}
+
+// Function-local optimization for the bodies regenerated by an incremental build. Only keeps cached
+// bodies small and warm, the output copies still go through the full module pipeline (inlining, IPO)
+void Compiler::optimizeFunctions(llvm::Module& module, const std::vector<std::string>& names) {
+    if (_options.optLevel == 0 || names.empty()) return;
+    const auto level = toOptimizationLevel(_options.optLevel);
+
+    llvm::LoopAnalysisManager LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager CGAM;
+    llvm::ModuleAnalysisManager MAM;
+
+    llvm::PassBuilder PB(targetMachine());
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    // Function passes only look at cached module analyses, make sure they exist
+    MAM.getResult<llvm::ProfileSummaryAnalysis>(module);
+
+    llvm::FunctionPassManager FPM = PB.buildFunctionSimplificationPipeline(level, llvm::ThinOrFullLTOPhase::None);
+    for (const auto& name : names) {
+        if (auto* function = module.getFunction(name); function && !function->isDeclaration()) {
+            FPM.run(*function, FAM);
+        }
+    }
+}
+
+// Bitcode with an embedded module summary, ready for a ThinLTO capable linker (lld, gold)
+std::string Compiler::thinLTOBitcode(llvm::Module& module) {
+    llvm::ModuleSummaryIndex index = llvm::buildModuleSummaryIndex(module, nullptr, nullptr);
+
+    std::string bitcode;
+    llvm::raw_string_ostream out(bitcode);
+    llvm::WriteBitcodeToFile(module, out, false, &index);
+    out.flush();
+    return bitcode;
+}
+
+} // namespace Nova::Compiler
@@ -0,0 +1,361 @@
+#include "query.h"
+#include "interface.h"
+#include "logger.h"
+#include <algorithm>
+#include <fstream>
+#include <llvm/IR/DerivedTypes.h>
+#include <sstream>
+
+namespace Nova::Compiler {
+
+QueryEngine::QueryEngine(Compiler& compiler) : _compiler(compiler) {}
+
+// ============================================================================
+// Result hashes, equal hashes let dependents keep their values
+// ============================================================================
+
+uint64_t QueryEngine::fingerprint(const std::vector<std::string>& lines) {
+    uint64_t hash = Compiler::hashText("lines");
+    for (const auto& line : lines) hash = Compiler::hashText(line, hash);
+    return hash;
+}
+
+uint64_t QueryEngine::fingerprint(const std::vector<FunctionSyntax>& functions) {
+    uint64_t hash = Compiler::hashText("functions");
+    for (const auto& function : functions) {
+        hash = Compiler::hashText(function.decl, Compiler::hashText(std::to_string(function.line), hash));
+        for (const auto& statement : function.statements) {
+            for (const auto& token : statement.tokens) hash = Compiler::hashText(token.token, hash);
+            hash = Compiler::hashText(";", hash);
+        }
+    }
+    return hash;
+}
+
+uint64_t QueryEngine::fingerprint(const std::vector<FunctionDeclaration>& declarations) {
+    uint64_t hash = Compiler::hashText("declarations");
+    for (const auto& decl : declarations) {
+        hash = Compiler::hashText(decl.returnType, Compiler::hashText(decl.name, hash));
+        for (const auto& arg : decl.args) hash = Compiler::hashText(arg, hash);
+    }
+    return hash;
+}
+
+// Types are uniqued by their context, the same pointer is the same type
+uint64_t QueryEngine::fingerprint(const std::vector<Signature>& signatures) {
+    uint64_t hash = Compiler::hashText("signatures");
+    for (const auto& signature : signatures) {
+        hash = Compiler::hashText(fmt::format("{}:{}", signature.name, static_cast<const void*>(signature.type)), hash);
+    }
+    return hash;
+}
+
+uint64_t QueryEngine::fingerprint(const std::vector<ParseError>& errors) {
+    uint64_t hash = Compiler::hashText("diagnostics");
+    for (const auto& error : errors) {
+        hash = Compiler::hashText(fmt::format("{}:{}:{}:{}", error.line, error.column, error.severity, error.message), hash);
+    }
+    return hash;
+}
+
+// ============================================================================
+// Memoization
+// ============================================================================
+
+template<typename T, typename Compute>
+const T& QueryEngine::fetch(Table<T>& table, Kind kind, const std::string& file, Compute compute) {
+    depend(kind, file);
+
+    if (const auto it = table.find(file); it != table.end()) {
+        auto& memo = it->second;
+        if (memo.verifiedAt == _revision) return memo.value;
+        if (upToDate(memo.deps, memo.verifiedAt)) {
+            memo.verifiedAt = _revision;
+            return memo.value;
+        }
+    }
+
+    std::vector<Key> deps;
+    _active.push_back(&deps);
+    T value = compute();
+    _active.pop_back();
+
+    const uint64_t hash = fingerprint(value);
+    auto& memo = table[file];
+    // Recomputed to the same thing (e.g. a body edit seen by declarations), dependents stay valid
+    if (memo.verifiedAt == 0 || memo.hash != hash) memo.changedAt = _revision;
+    memo.value = std::move(value);
+    memo.hash = hash;
+    memo.verifiedAt = _revision;
+    memo.deps = std::move(deps);
+    return memo.value;
+}
+
+// Dependencies are brought up to date first, only a value that changed after ours was checked counts
+bool QueryEngine::upToDate(const std::vector<Key>& deps, uint64_t verifiedAt) {
+    _active.push_back(nullptr);
+    const bool current = std::all_of(deps.begin(), deps.end(), [&](const Key& key) { return changedAt(key) <= verifiedAt; });
+    _active.pop_back();
+    return current;
+}
+
+uint64_t QueryEngine::changedAt(const Key& key) {
+    switch (key.kind) {
+        case Kind::Text: return input(key.file).changedAt;
+        case Kind::Context: return _contextChangedAt;
+        case Kind::Lines: lines(key.file); return _lines.at(key.file).changedAt;
+        case Kind::Functions: functions(key.file); return _functions.at(key.file).changedAt;
+        case Kind::Declarations: declarations(key.file); return _declarations.at(key.file).changedAt;
+        case Kind::Signatures: signatures(key.file); return _signatures.at(key.file).changedAt;
+        case Kind::Diagnostics: diagnostics(key.file); return _diagnostics.at(key.file).changedAt;
+    }
+    return _revision;
+}
+
+void QueryEngine::depend(Kind kind, const std::string& file) {
+    if (!_active.empty() && _active.back()) _active.back()->push_back(Key{kind, file});
+}
+
+// ============================================================================
+// Inputs
+// ============================================================================
+
+QueryEngine::Input& QueryEngine::input(const std::string& file) {
+    auto [it, inserted] = _inputs.try_emplace(file);
+    if (inserted) {
+        load(it->second, file);
+        it->second.changedAt = _revision;
+    }
+    return it->second;
+}
+
+// True when the contents differ from what the input held before
+bool QueryEngine::load(Input& input, const std::string& file) {
+    std::error_code ec;
+    input.mtime = std::filesystem::last_write_time(file, ec);
+    input.size = ec ? 0 : std::filesystem::file_size(file, ec);
+
+    std::string text;
+    std::ifstream stream(file, std::ios::binary);
+    input.readable = stream.is_open();
+    if (input.readable) {
+        std::ostringstream contents;
+        contents << stream.rdbuf();
+        text = std::move(contents).str();
+    }
+
+    const uint64_t hash = Compiler::hashText(text);
+    if (hash == input.hash && text == input.text) return false;
+    input.text = std::move(text);
+    input.hash = hash;
+    return true;
+}
+
+void QueryEngine::setText(const std::string& file, std::string text) {
+    auto& entry = _inputs[file];
+    entry.open = true;
+    entry.readable = true;
+    if (entry.changedAt != 0 && entry.text == text) return;
+
+    _revision++;
+    entry.hash = Compiler::hashText(text);
+    entry.text = std::move(text);
+    entry.changedAt = _revision;
+}
+
+void QueryEngine::closeText(const std::string& file) {
+    const auto it = _inputs.find(file);
+    if (it == _inputs.end() || !it->second.open) return;
+
+    it->second.open = false;
+    it->second.mtime = {};
+    refresh();
+}
+
+bool QueryEngine::refresh() {
+    bool changed = false;
+    for (auto& [file, entry] : _inputs) {
+        if (entry.open) continue;
+
+        std::error_code ec;
+        const auto mtime = std::filesystem::last_write_time(file, ec);
+        const auto size = ec ? 0 : std::filesystem::file_size(file, ec);
+        if (mtime == entry.mtime && size == entry.size && entry.readable == !ec) continue;
+
+        // A touched file with the same bytes is not a change
+        if (!load(entry, file)) continue;
+        if (!changed) _revision++;
+        changed = true;
+        entry.changedAt = _revision;
+    }
+    return changed;
+}
+
+void QueryEngine::invalidateTypes() {
+    _revision++;
+    _contextChangedAt = _revision;
+}
+
+// ============================================================================
+// Queries
+// ============================================================================
+
+const std::string& QueryEngine::text(const std::string& file) {
+    depend(Kind::Text, file);
+    return input(file).text;
+}
+
+bool QueryEngine::readable(const std::string& file) {
+    depend(Kind::Text, file);
+    return input(file).readable;
+}
+
+const std::vector<std::string>& QueryEngine::lines(const std::string& file) {
+    return fetch(_lines, Kind::Lines, file, [&]() {
+        std::vector<std::string> result;
+        std::istringstream stream(text(file));
+        std::string line;
+        while (std::getline(stream, line)) result.push_back(line);
+        return result;
+    });
+}
+
+const std::vector<QueryEngine::FunctionSyntax>& QueryEngine::functions(const std::string& file) {
+    return fetch(_functions, Kind::Functions, file, [&]() {
+        const auto& source = lines(file);
+        std::vector<FunctionSyntax> result;
+        for (size_t i = 0; i < source.size(); i++) {
+            if (source[i].find("func ") == std::string::npos) continue;
+
+            FunctionSyntax function;
+            function.line = i;
+            const auto code = _compiler.functionBody(source, i, function.decl);
+            const auto declaration = _compiler.parseFunctionDeclaration(function.decl, false);
+            if (declaration.valid) function.name = declaration.name;
+            for (const auto& statement : code) {
+                auto assignments = _compiler.splitCall(statement);
+                function.statements.insert(function.statements.end(), assignments.begin(), assignments.end());
+            }
+            result.push_back(std::move(function));
+        }
+        return result;
+    });
+}
+
+// Headers use "func name(args) -> type;", so this reads lines instead of function bodies
+const std::vector<FunctionDeclaration>& QueryEngine::declarations(const std::string& file) {
+    return fetch(_declarations, Kind::Declarations, file, [&]() {
+        std::vector<FunctionDeclaration> result;
+        for (const auto& line : lines(file)) {
+            if (line.find("func ") == std::string::npos) continue;
+
+            auto decl = _compiler.parseFunctionDeclaration(line.substr(0, line.find_first_of("{;")), false);
+            if (decl.valid) result.push_back(std::move(decl));
+        }
+        return result;
+    });
+}
+
+const std::vector<QueryEngine::Signature>& QueryEngine::signatures(const std::string& file) {
+    return fetch(_signatures, Kind::Signatures, file, [&]() {
+        depend(Kind::Context, "");
+        auto& ctx = _compiler.llvmContext();
+
+        // Unknown and malformed types are reported by diagnostics(), resolving them stays quiet
+        std::vector<ParseError> ignored;
+        auto* savedDiagnostics = std::exchange(_compiler._diagnostics, &ignored);
+
+        std::vector<Signature> result;
+        for (const auto& decl : declarations(file)) {
+            Signature signature{decl.name};
+            llvm::Type* returnType = _compiler.novaTypeToLLVM(decl.returnType, ctx);
+
+            std::vector<llvm::Type*> params;
+            bool resolved = returnType != nullptr;
+            for (const auto& arg : decl.args) {
+                const auto parts = _compiler.tokenize(arg);
+                llvm::Type* type = _compiler.novaTypeToLLVM(parts.size() > 1 ? parts[0] : "int", ctx);
+                resolved = resolved && type != nullptr && !type->isVoidTy();
+                params.push_back(type);
+            }
+            if (resolved) signature.type = llvm::FunctionType::get(returnType, params, false);
+            result.push_back(std::move(signature));
+        }
+        _compiler._diagnostics = savedDiagnostics;
+        return result;
+    });
+}
+
+// Same checks as --check, against the declarations of the file's project and its packages
+const std::vector<ParseError>& QueryEngine::diagnostics(const std::string& file) {
+    return fetch(_diagnostics, Kind::Diagnostics, file, [&]() {
+        const auto [own, packages] = scope(file);
+
+        std::unordered_map<std::string, size_t> definitions;
+        std::unordered_map<std::string, FunctionDeclaration> visible;
+        for (const auto& source : own) {
+            for (const auto& decl : declarations(source)) {
+                definitions[decl.name]++;
+                visible[decl.name] = decl;
+            }
+        }
+        for (const auto& source : packages) {
+            for (const auto& decl : declarations(source)) visible.try_emplace(decl.name, decl);
+        }
+
+        // checkSource resolves calls through the compiler, it gets this file's view for the duration
+        auto savedDeclarations = std::exchange(_compiler._declarations, std::move(visible));
+        auto savedImports = std::exchange(_compiler._imports, {});
+        auto errors = _compiler.checkSource(file, lines(file), definitions);
+        _compiler._declarations = std::move(savedDeclarations);
+        _compiler._imports = std::move(savedImports);
+        return errors;
+    });
+}
+
+std::optional<QueryEngine::Symbol> QueryEngine::lookup(const std::string& file, const std::string& name) {
+    const auto [own, packages] = scope(file);
+    for (const auto* sources : {&own, &packages}) {
+        for (const auto& source : *sources) {
+            const auto& decls = declarations(source);
+            const auto it = std::find_if(decls.begin(), decls.end(), [&](const FunctionDeclaration& decl) { return decl.name == name; });
+            if (it == decls.end()) continue;
+
+            // Signatures are in declaration order
+            const auto& types = signatures(source);
+            return Symbol{source, *it, types[it - decls.begin()].type};
+        }
+    }
+    return std::nullopt;
+}
+
+std::pair<std::vector<std::string>, std::vector<std::string>> QueryEngine::scope(const std::string& file) const {
+    const auto& projects = _compiler.projects();
+    const auto project = std::find_if(projects.begin(), projects.end(), [&](const Project& p) {
+        return std::find(p.files.begin(), p.files.end(), file) != p.files.end();
+    });
+    if (project == projects.end()) return {{file}, {}};
+
+    std::vector<std::string> packages;
+    for (const auto& dependency : project->dependencies) {
+        const auto it = std::find_if(projects.begin(), projects.end(), [&](const Project& p) { return p.name == dependency; });
+        if (it == projects.end()) continue;
+        const auto& files = it->headers.empty() ? it->files : it->headers;
+        packages.insert(packages.end(), files.begin(), files.end());
+    }
+    return {project->files, packages};
+}
+
+std::string QueryEngine::resolve(const std::string& path) const {
+    std::error_code ec;
+    for (const auto& project : _compiler.projects()) {
+        for (const auto* files : {&project.files, &project.headers}) {
+            for (const auto& file : *files) {
+                if (file == path || std::filesystem::equivalent(file, path, ec)) return file;
+            }
+        }
+    }
+    return path;
+}
+
+} // namespace Nova::Compiler
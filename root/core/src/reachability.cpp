@@ -0,0 +1,76 @@
+#include "compiler.h"
+#include "logger.h"
+#include "query.h"
+
+namespace Nova::Compiler {
+
+// Callees of every function in the files, straight from the tokens: an identifier followed by '('
+std::unordered_map<std::string, std::vector<std::string>> Compiler::buildCallGraph(const std::vector<std::string>& files) {
+    std::unordered_map<std::string, std::vector<std::string>> graph;
+    for (const auto& path : files) {
+        for (const auto& function : queries().functions(path)) {
+            if (function.name.empty()) continue;
+
+            auto& callees = graph[function.name];
+            for (const auto& assignment : function.statements) {
+                const auto& tokens = assignment.tokens;
+                for (size_t t = 0; t + 1 < tokens.size(); t++) {
+                    if (tokens[t].type == TokenType::Identifier && tokens[t + 1].type == TokenType::LParen) {
+                        callees.push_back(tokens[t].token);
+                    }
+                }
+            }
+        }
+    }
+    return graph;
+}
+
+// Everything main and the exported functions can call, directly or through other functions
+std::unordered_set<std::string> Compiler::reachableFunctions(const Project& project) {
+    const auto graph = buildCallGraph(project.files);
+    const auto roots = exportedFunctions(project);
+
+    std::unordered_set<std::string> reachable(roots.begin(), roots.end());
+    std::vector<std::string> worklist(roots.begin(), roots.end());
+    while (!worklist.empty()) {
+        const auto name = std::move(worklist.back());
+        worklist.pop_back();
+
+        const auto it = graph.find(name);
+        if (it == graph.end()) continue;
+        for (const auto& callee : it->second) {
+            if (reachable.insert(callee).second) worklist.push_back(callee);
+        }
+    }
+    return reachable;
+}
+
+// Malformed declarations stay "reachable" so parseFunction still reports them
+bool Compiler::isReachable(const std::string& funcLine) {
+    if (!_treeShaking) return true;
+
+    const auto decl = parseFunctionDeclaration(funcLine.substr(0, funcLine.find_first_of("{;")), false);
+    return !decl.valid || _reachable.contains(decl.name);
+}
+
+// Cached modules can still hold functions that were reachable in an earlier build
+void Compiler::dropUnreachable(llvm::Module* module) {
+    std::vector<llvm::Function*> dead;
+    for (auto& function : *module) {
+        if (!function.isDeclaration() && !_reachable.contains(function.getName().str())) dead.push_back(&function);
+    }
+    if (dead.empty()) return;
+
+    // Only other unreachable functions call them, their references go first
+    for (auto* function : dead) function->dropAllReferences();
+    for (auto* function : dead) {
+        if (_activeCache) _activeCache->fingerprints.erase(function->getName().str());
+        if (function->use_empty()) {
+            function->eraseFromParent();
+        }else {
+            function->deleteBody();
+        }
+    }
+}
+
+} // namespace Nova::Compiler
@@ -0,0 +1,129 @@
+#include "compiler.h"
+#include "logger.h"
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/TargetParser/Host.h>
+#include <llvm/TargetParser/SubtargetFeature.h>
+#include <llvm/TargetParser/Triple.h>
+#include <mutex>
+
+namespace Nova::Compiler {
+
+static void initializeTargets() {
+    static std::once_flag once;
+    std::call_once(once, []() {
+        llvm::InitializeAllTargetInfos();
+        llvm::InitializeAllTargets();
+        llvm::InitializeAllTargetMCs();
+        llvm::InitializeAllAsmPrinters();
+        llvm::InitializeAllAsmParsers();
+    });
+}
+
+static llvm::CodeGenOptLevel toCodeGenOptLevel(unsigned level) {
+    switch (level) {
+        case 0: return llvm::CodeGenOptLevel::None;
+        case 1: return llvm::CodeGenOptLevel::Less;
+        case 2: return llvm::CodeGenOptLevel::Default;
+        default: return llvm::CodeGenOptLevel::Aggressive;
+    }
+}
+
+static void applyTargetOS(llvm::Triple& triple, const std::string& os) {
+    if (os == "linux") {
+        triple.setOS(llvm::Triple::Linux);
+    }else if (os == "windows") {
+        triple.setOS(llvm::Triple::Win32);
+    }else if (os == "macos") {
+        triple.setVendor(llvm::Triple::Apple);
+        triple.setOS(llvm::Triple::MacOSX);
+    }else if (!os.empty()) {
+        NWARN("Unknown targetOS '{}' - using host OS", os);
+    }
+}
+
+// Merges command line and nc.conf, "native" gets replaced by what the host reports
+TargetSpec Compiler::resolveTarget() const {
+    TargetSpec spec = _configTarget;
+    if (!_options.target.triple.empty()) spec.triple = _options.target.triple;
+    if (!_options.target.cpu.empty()) spec.cpu = _options.target.cpu;
+    if (!_options.target.features.empty()) spec.features = _options.target.features;
+    if (!_options.target.os.empty()) spec.os = _options.target.os;
+
+    const llvm::Triple host(llvm::sys::getProcessTriple());
+    llvm::Triple triple = host;
+    if (spec.triple.empty() || spec.triple == "native") {
+        // targetOS only matters when no explicit triple is given
+        if (spec.triple.empty()) applyTargetOS(triple, spec.os);
+    }else {
+        triple = llvm::Triple(llvm::Triple::normalize(spec.triple));
+    }
+    spec.triple = triple.str();
+
+    if (spec.cpu == "native") {
+        if (triple.getArch() != host.getArch()) {
+            NWARN("--cpu=native ignored when cross compiling to {}", spec.triple);
+            spec.cpu.clear();
+        }else {
+            spec.cpu = llvm::sys::getHostCPUName().str();
+
+            llvm::SubtargetFeatures features;
+            for (const auto& feature : llvm::sys::getHostCPUFeatures()) {
+                features.AddFeature(feature.first(), feature.second);
+            }
+            // User features go last so they can turn host features off again
+            for (const auto& feature : llvm::SubtargetFeatures(spec.features).getFeatures()) {
+                features.AddFeature(feature);
+            }
+            spec.features = features.getString();
+        }
+    }
+
+    return spec;
+}
+
+// A machine per caller, codegen threads can not share one
+std::unique_ptr<llvm::TargetMachine> Compiler::createTargetMachine() const {
+    initializeTargets();
+
+    const auto spec = resolveTarget();
+    const llvm::Triple triple(spec.triple);
+
+    std::string error;
+    const auto* target = llvm::TargetRegistry::lookupTarget(triple.str(), error);
+    if (!target) {
+        NERROR("Unsupported target {}: {}", spec.triple, error);
+        return nullptr;
+    }
+
+    llvm::TargetOptions targetOptions;
+    std::unique_ptr<llvm::TargetMachine> machine(target->createTargetMachine(
+        triple,
+        spec.cpu,
+        spec.features,
+        targetOptions,
+        llvm::Reloc::PIC_,
+        std::nullopt,
+        toCodeGenOptLevel(_options.optLevel)
+    ));
+
+    if (!machine) {
+        NERROR("Failed to create target machine for {}", spec.triple);
+        return nullptr;
+    }
+    return machine;
+}
+
+llvm::TargetMachine* Compiler::targetMachine() {
+    if (_targetMachine) return _targetMachine.get();
+
+    _targetMachine = createTargetMachine();
+    if (!_targetMachine) return nullptr;
+
+    const auto spec = resolveTarget();
+    NCINFO("Target: {} (cpu: {})", spec.triple, spec.cpu.empty() ? "generic" : spec.cpu);
+    return _targetMachine.get();
+}
+
+} // namespace Nova::Compiler
@@ -0,0 +1,181 @@
+#include "tests.h"
+#include "compiler.h"
+#include "query.h"
+#include <algorithm>
+#include <cstdint>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+
+using namespace Nova::Compiler;
+
+static CompileResult compileSource(const std::string& source) {
+    Compiler compiler{BuildOptions{}};
+    return compiler.compile({VirtualFile{"expressions.nl", source}});
+}
+
+// Value of the first ret in function name
+static llvm::Value* returned(const CompileResult& result, const char* name) {
+    auto* function = result.module->getFunction(name);
+    if (function == nullptr) return nullptr;
+    for (auto& block : *function) {
+        if (auto* ret = llvm::dyn_cast<llvm::ReturnInst>(block.getTerminator())) return ret->getReturnValue();
+    }
+    return nullptr;
+}
+
+// Binary instruction with the given opcode, null operands match anything
+static bool isBinary(llvm::Value* value, unsigned opcode, llvm::Value* lhs = nullptr, llvm::Value* rhs = nullptr) {
+    auto* binary = llvm::dyn_cast_or_null<llvm::BinaryOperator>(value);
+    if (binary == nullptr || binary->getOpcode() != opcode) return false;
+    return (lhs == nullptr || binary->getOperand(0) == lhs) && (rhs == nullptr || binary->getOperand(1) == rhs);
+}
+
+static bool isInteger(llvm::Value* value, int64_t expected) {
+    auto* constant = llvm::dyn_cast_or_null<llvm::ConstantInt>(value);
+    return constant != nullptr && constant->getSExtValue() == expected;
+}
+
+NOVA_TEST(multiplicationBindsTighterThanAddition) {
+    const auto result = compileSource(
+        "func f(int a, int b, int c) -> int { ret a + b * c }\n"
+        "func g(int a, int b, int c) -> int { ret a * b + c }\n");
+    NOVA_REQUIRE(result.valid());
+
+    auto* f = result.module->getFunction("f");
+    auto* fRet = returned(result, "f");
+    NOVA_CHECK(isBinary(fRet, llvm::Instruction::Add, f->getArg(0)));
+    NOVA_CHECK(isBinary(llvm::cast<llvm::User>(fRet)->getOperand(1), llvm::Instruction::Mul, f->getArg(1), f->getArg(2)));
+
+    auto* g = result.module->getFunction("g");
+    auto* gRet = returned(result, "g");
+    NOVA_CHECK(isBinary(gRet, llvm::Instruction::Add, nullptr, g->getArg(2)));
+    NOVA_CHECK(isBinary(llvm::cast<llvm::User>(gRet)->getOperand(0), llvm::Instruction::Mul, g->getArg(0), g->getArg(1)));
+}
+
+NOVA_TEST(sameLevelOperatorsAreLeftAssociative) {
+    const auto result = compileSource(
+        "func sub(int a, int b, int c) -> int { ret a - b - c }\n"
+        "func div(int a, int b, int c) -> int { ret a / b / c }\n");
+    NOVA_REQUIRE(result.valid());
+
+    auto* sub = result.module->getFunction("sub");
+    auto* subRet = returned(result, "sub");
+    NOVA_CHECK(isBinary(subRet, llvm::Instruction::Sub, nullptr, sub->getArg(2)));
+    NOVA_CHECK(isBinary(llvm::cast<llvm::User>(subRet)->getOperand(0), llvm::Instruction::Sub, sub->getArg(0), sub->getArg(1)));
+
+    auto* div = result.module->getFunction("div");
+    auto* divRet = returned(result, "div");
+    NOVA_CHECK(isBinary(divRet, llvm::Instruction::SDiv, nullptr, div->getArg(2)));
+    NOVA_CHECK(isBinary(llvm::cast<llvm::User>(divRet)->getOperand(0), llvm::Instruction::SDiv, div->getArg(0), div->getArg(1)));
+}
+
+NOVA_TEST(parenthesesAndNegation) {
+    const auto result = compileSource(
+        "func group(int a, int b, int c) -> int { ret (a + b) * c }\n"
+        "func negate(int a, int b) -> int { ret -a * b }\n");
+    NOVA_REQUIRE(result.valid());
+
+    auto* group = result.module->getFunction("group");
+    auto* groupRet = returned(result, "group");
+    NOVA_CHECK(isBinary(groupRet, llvm::Instruction::Mul, nullptr, group->getArg(2)));
+    NOVA_CHECK(isBinary(llvm::cast<llvm::User>(groupRet)->getOperand(0), llvm::Instruction::Add, group->getArg(0), group->getArg(1)));
+
+    // Unary minus applies to the operand, not to the product
+    auto* negate = result.module->getFunction("negate");
+    auto* negateRet = returned(result, "negate");
+    NOVA_CHECK(isBinary(negateRet, llvm::Instruction::Mul, nullptr, negate->getArg(1)));
+    NOVA_CHECK(isBinary(llvm::cast<llvm::User>(negateRet)->getOperand(0), llvm::Instruction::Sub, nullptr, negate->getArg(0)));
+}
+
+NOVA_TEST(constantsAreFolded) {
+    const auto result = compileSource(
+        "func a() -> int { ret 2 + 3 * 4 }\n"
+        "func b() -> int { ret (2 + 3) * 4 }\n"
+        "func c() -> int { ret 10 - 4 - 3 }\n"
+        "func d() -> int { ret -7 / 2 }\n");
+    NOVA_REQUIRE(result.valid());
+
+    NOVA_CHECK(isInteger(returned(result, "a"), 14));
+    NOVA_CHECK(isInteger(returned(result, "b"), 20));
+    NOVA_CHECK(isInteger(returned(result, "c"), 3));
+    NOVA_CHECK(isInteger(returned(result, "d"), -3)); // Truncates toward zero like sdiv
+}
+
+// Overflowing constants are left to LLVM, which wraps them the way the instruction would at run time
+NOVA_TEST(overflowingConstantsWrap) {
+    const auto result = compileSource(
+        "func add() -> int { ret 9223372036854775807 + 1 }\n"
+        "func mul() -> int { ret 9223372036854775807 * 2 }\n"
+        "func sub() -> int { ret -9223372036854775808 - 1 }\n");
+    NOVA_REQUIRE(result.valid());
+
+    NOVA_CHECK(isInteger(returned(result, "add"), INT64_MIN));
+    NOVA_CHECK(isInteger(returned(result, "mul"), -2));
+    NOVA_CHECK(isInteger(returned(result, "sub"), INT64_MAX));
+}
+
+// The folder must neither trap in the compiler nor make up a value for undefined divisions
+NOVA_TEST(undefinedDivisionsAreNotFolded) {
+    const auto result = compileSource(
+        "func zero() -> int { ret 1 / 0 }\n"
+        "func minByMinusOne() -> int { ret -9223372036854775808 / -1 }\n"
+        "func floatZero() -> double { ret 1.0 / 0.0 }\n");
+    NOVA_REQUIRE(result.valid());
+
+    NOVA_CHECK(!llvm::isa_and_nonnull<llvm::ConstantInt>(returned(result, "zero")));
+    NOVA_CHECK(!llvm::isa_and_nonnull<llvm::ConstantInt>(returned(result, "minByMinusOne")));
+
+    auto* infinity = llvm::dyn_cast_or_null<llvm::ConstantFP>(returned(result, "floatZero"));
+    NOVA_CHECK(infinity != nullptr && infinity->getValueAPF().isInfinity());
+}
+
+// Every way of reaching a const through an assignment, nested ones included
+static const char* CONSTANT_ASSIGNMENTS[] = {
+    "func f() -> int {\n    const c = 1\n    c = 2\n    ret c\n}\n",
+    "func f() -> int {\n    const c = 1\n    var x = 0\n    x = c = 3\n    ret x\n}\n",
+    "func f() -> int {\n    const c = 1\n    var y = (c = 5)\n    ret y\n}\n",
+    "func f() -> int {\n    const c = 1\n    ret c = 1\n}\n",
+    "func g(int x) -> int { ret x }\nfunc f() -> int {\n    const c = 1\n    ret g((c = 2))\n}\n",
+};
+
+static bool mentions(const std::vector<ParseError>& errors, const std::string& text) {
+    return std::any_of(errors.begin(), errors.end(), [&](const ParseError& error) {
+        return error.severity == "error" && error.message.find(text) != std::string::npos;
+    });
+}
+
+NOVA_TEST(constantsCanNotBeAssigned) {
+    for (const char* source : CONSTANT_ASSIGNMENTS) {
+        const auto result = compileSource(source);
+        NOVA_CHECK(!result.valid());
+        NOVA_CHECK(mentions(result.diagnostics, "Can not assign to constant 'c'"));
+    }
+}
+
+// --check goes through the query engine, it has to agree with code generation
+NOVA_TEST(checkerRejectsConstantAssignments) {
+    Compiler compiler{BuildOptions{}};
+    auto& queries = compiler.queries();
+    for (const char* source : CONSTANT_ASSIGNMENTS) {
+        queries.setText("constants.nl", source);
+        NOVA_CHECK(mentions(queries.diagnostics("constants.nl"), "Can not assign to constant 'c'"));
+    }
+}
+
+NOVA_TEST(constantsCanNotBeRedeclared) {
+    const char* source = "func f() -> int {\n    const c = 1\n    var c = 2\n    ret c\n}\n";
+
+    const auto result = compileSource(source);
+    NOVA_CHECK(!result.valid());
+    NOVA_CHECK(mentions(result.diagnostics, "'c' is already declared"));
+
+    Compiler compiler{BuildOptions{}};
+    compiler.queries().setText("constants.nl", source);
+    NOVA_CHECK(mentions(compiler.queries().diagnostics("constants.nl"), "'c' is already declared"));
+}
+
+NOVA_TEST(variablesCanBeAssignedInExpressions) {
+    const auto result = compileSource("func f() -> int {\n    var a = 1\n    var b = 0\n    b = a = 3\n    ret a + b\n}\n");
+    NOVA_REQUIRE(result.valid());
+    NOVA_CHECK(isInteger(returned(result, "f"), 6));
+}
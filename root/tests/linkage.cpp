@@ -0,0 +1,211 @@
+#include "tests.h"
+#include "compiler.h"
+#include <filesystem>
+#include <fstream>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/SourceMgr.h>
+
+using namespace Nova::Compiler;
+
+namespace {
+
+    // Sources and outputs in a fresh temporary directory, removed again at the end of the test
+    struct Workspace {
+        std::filesystem::path dir;
+
+        Workspace() {
+            llvm::SmallString<128> path;
+            llvm::sys::fs::createUniqueDirectory("nova-linkage", path);
+            dir = path.str().str();
+        }
+
+        ~Workspace() {
+            std::error_code ec;
+            std::filesystem::remove_all(dir, ec);
+        }
+
+        std::string write(const std::string& name, const std::string& source) const {
+            std::error_code ec;
+            std::filesystem::create_directories((dir / name).parent_path(), ec);
+            std::ofstream(dir / name) << source;
+            return (dir / name).string();
+        }
+    };
+
+    // Every call must use its callee's convention, a mismatch is undefined behavior that -O1 turns into unreachable
+    bool callsMatchCallees(const llvm::Module& module) {
+        for (const auto& function : module) {
+            for (const auto& block : function) {
+                for (const auto& instruction : block) {
+                    const auto* call = llvm::dyn_cast<llvm::CallBase>(&instruction);
+                    if (call && call->getCalledFunction() && call->getCallingConv() != call->getCalledFunction()->getCallingConv()) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+} // namespace
+
+static const char* MAIN_SOURCE = "func main() -> int { ret twice(21) }\n";
+static const char* UTIL_SOURCE =
+    "func twice(int x) -> int { ret add(x, x) }\n"
+    "func add(int a, int b) -> int { ret a + b }\n";
+
+NOVA_TEST(linkageFollowsWhereFunctionsAreUsed) {
+    Workspace workspace;
+    Project project;
+    project.name = "linkage";
+    project.type = ProjectType::Executable;
+    project.files = {workspace.write("main.nl", MAIN_SOURCE), workspace.write("util.nl", UTIL_SOURCE)};
+
+    Compiler compiler{BuildOptions{}};
+    compiler.addProject(project);
+    compiler.generateAll(workspace.dir.string());
+
+    llvm::LLVMContext context;
+    llvm::SMDiagnostic error;
+    auto main = llvm::parseIRFile((workspace.dir / "main.ll").string(), error, context);
+    auto util = llvm::parseIRFile((workspace.dir / "util.ll").string(), error, context);
+    NOVA_REQUIRE(main && util);
+
+    // Called from outside the project
+    const auto* mainFunction = main->getFunction("main");
+    NOVA_REQUIRE(mainFunction != nullptr);
+    NOVA_CHECK(mainFunction->hasExternalLinkage());
+    NOVA_CHECK(mainFunction->hasDefaultVisibility());
+    NOVA_CHECK(mainFunction->getCallingConv() == llvm::CallingConv::C);
+
+    // Shared between the two files of the project
+    const auto* twice = util->getFunction("twice");
+    NOVA_REQUIRE(twice != nullptr);
+    NOVA_CHECK(twice->hasExternalLinkage());
+    NOVA_CHECK(twice->hasHiddenVisibility());
+    NOVA_CHECK(twice->getCallingConv() == llvm::CallingConv::Fast);
+
+    const auto* twiceDeclaration = main->getFunction("twice");
+    NOVA_REQUIRE(twiceDeclaration != nullptr);
+    NOVA_CHECK(twiceDeclaration->getCallingConv() == llvm::CallingConv::Fast);
+
+    // Only used in its own file
+    const auto* add = util->getFunction("add");
+    NOVA_REQUIRE(add != nullptr);
+    NOVA_CHECK(add->hasInternalLinkage());
+    NOVA_CHECK(add->getCallingConv() == llvm::CallingConv::Fast);
+
+    NOVA_CHECK(callsMatchCallees(*main));
+    NOVA_CHECK(callsMatchCallees(*util));
+}
+
+// Linkage is applied to output copies, cached modules reused by a rebuild keep their C declarations
+NOVA_TEST(incrementalRebuildKeepsConventionsConsistent) {
+    Workspace workspace;
+    Project project;
+    project.name = "linkage";
+    project.type = ProjectType::Executable;
+    project.files = {workspace.write("main.nl", MAIN_SOURCE), workspace.write("util.nl", UTIL_SOURCE)};
+
+    BuildOptions options;
+    options.optLevel = 2;
+    Compiler compiler{options};
+    compiler.addProject(project);
+    compiler.generateAll(workspace.dir.string());
+
+    workspace.write("util.nl",
+        "func twice(int x) -> int { ret add(x, x) + 0 }\n"
+        "func add(int a, int b) -> int { ret a + b }\n");
+    compiler.generateAll(workspace.dir.string());
+
+    // At -O1 and above a mismatch inside a cached module turns the caller into unreachable
+    llvm::LLVMContext context;
+    llvm::SMDiagnostic error;
+    for (const char* output : {"main.ll", "util.ll"}) {
+        auto module = llvm::parseIRFile((workspace.dir / output).string(), error, context);
+        NOVA_REQUIRE(module);
+        NOVA_CHECK(callsMatchCallees(*module));
+        for (const auto& function : *module) {
+            for (const auto& block : function) {
+                for (const auto& instruction : block) NOVA_CHECK(!llvm::isa<llvm::UnreachableInst>(instruction));
+            }
+        }
+    }
+}
+
+// Files of the same name in different directories, their outputs must not overwrite each other
+NOVA_TEST(outputsMirrorTheSourceTree) {
+    Workspace workspace;
+    Project project;
+    project.name = "layout";
+    project.type = ProjectType::Executable;
+    project.sourceDir = workspace.dir;
+    project.files = {
+        workspace.write("main.nl", "func main() -> int { ret first(1) + second(2) }\n"),
+        workspace.write("a/util.nl", "func first(int x) -> int { ret x }\n"),
+        workspace.write("b/util.nl", "func second(int x) -> int { ret x + x }\n"),
+    };
+
+    BuildOptions options;
+    options.emitObjects = true;
+    Compiler compiler{options};
+    compiler.addProject(project);
+    compiler.generateAll(workspace.dir.string());
+
+    llvm::LLVMContext context;
+    llvm::SMDiagnostic error;
+    auto first = llvm::parseIRFile((workspace.dir / "a" / "util.ll").string(), error, context);
+    auto second = llvm::parseIRFile((workspace.dir / "b" / "util.ll").string(), error, context);
+    NOVA_REQUIRE(first && second);
+    NOVA_CHECK(first->getFunction("first") && !first->getFunction("first")->isDeclaration());
+    NOVA_CHECK(second->getFunction("second") && !second->getFunction("second")->isDeclaration());
+    NOVA_CHECK(std::filesystem::exists(workspace.dir / "a" / "util.o"));
+    NOVA_CHECK(std::filesystem::exists(workspace.dir / "b" / "util.o"));
+    NOVA_CHECK(!std::filesystem::exists(workspace.dir / "util.ll"));
+}
+
+// Enough functions for several codegen partitions, every one but main is internal after linkage inference
+NOVA_TEST(splitCodegenKeepsInternalFunctionsLocal) {
+    Workspace workspace;
+    std::string source = "func main() -> int { ret f0(1) }\n";
+    for (int i = 0; i < 96; i++) source += fmt::format("func f{}(int x) -> int {{ ret x * {} + f{}(x) }}\n", i, i, i + 1);
+    source += "func f96(int x) -> int { ret x }\n";
+
+    Project project;
+    project.name = "split";
+    project.type = ProjectType::Executable;
+    project.files = {workspace.write("split.nl", source)};
+
+    BuildOptions options;
+    options.emitObjects = true;
+    options.codegenThreads = 4;
+    Compiler compiler{options};
+    compiler.addProject(project);
+    compiler.generateAll(workspace.dir.string());
+
+    auto object = llvm::object::ObjectFile::createObjectFile((workspace.dir / "split.o").string());
+    NOVA_REQUIRE(static_cast<bool>(object));
+
+    size_t functions = 0;
+    for (const auto& symbol : object->getBinary()->symbols()) {
+        auto name = symbol.getName();
+        auto flags = symbol.getFlags();
+        if (!name || !flags) {
+            llvm::consumeError(name.takeError());
+            llvm::consumeError(flags.takeError());
+            continue;
+        }
+        if (*name == "main") {
+            NOVA_CHECK((*flags & llvm::object::SymbolRef::SF_Global) != 0);
+        }else if (name->starts_with("f") && (*flags & llvm::object::SymbolRef::SF_Undefined) == 0) {
+            // A global f<N> would clash with any other object defining the same helper
+            NOVA_CHECK((*flags & llvm::object::SymbolRef::SF_Global) == 0);
+            functions++;
+        }
+    }
+    NOVA_CHECK(functions > 0);
+}
@@ -0,0 +1,20 @@
+#include "tests.h"
+#include <cstdlib>
+#include <cstring>
+
+// Runs every registered test, or only those whose name contains argv[1]
+int main(int argc, char** argv) {
+    int ran = 0;
+    for (const auto& test : Nova::Tests::registry()) {
+        if (argc > 1 && std::strstr(test.name, argv[1]) == nullptr) continue;
+
+        const int before = Nova::Tests::failures();
+        fmt::print(stderr, "[ RUN  ] {}\n", test.name);
+        test.run();
+        fmt::print(stderr, "[ {} ] {}\n", Nova::Tests::failures() == before ? " OK " : "FAIL", test.name);
+        ran++;
+    }
+
+    fmt::print(stderr, "{} tests, {} failed checks\n", ran, Nova::Tests::failures());
+    return Nova::Tests::failures() == 0 && ran > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,79 @@
+#include "tests.h"
+#include "compiler.h"
+#include "query.h"
+#include <algorithm>
+
+using namespace Nova::Compiler;
+
+// Editor buffers only, the files never exist on disk
+static void addProject(Compiler& compiler) {
+    Project project;
+    project.name = "query";
+    project.type = ProjectType::Executable;
+    project.files = {"twice.nl", "main.nl"};
+    compiler.addProject(std::move(project));
+}
+
+static bool mentions(const std::vector<ParseError>& errors, const std::string& text) {
+    return std::any_of(errors.begin(), errors.end(), [&](const ParseError& error) {
+        return error.message.find(text) != std::string::npos;
+    });
+}
+
+NOVA_TEST(editsReachFilesUsingTheChangedDeclarations) {
+    Compiler compiler{BuildOptions{}};
+    addProject(compiler);
+    auto& queries = compiler.queries();
+
+    queries.setText("twice.nl", "func twice(int x) -> int { ret x * 2 }\n");
+    queries.setText("main.nl", "func main() -> int { ret twice(21) }\n");
+    NOVA_CHECK(queries.diagnostics("main.nl").empty());
+
+    // Body only, the declarations main.nl sees stay the same
+    queries.setText("twice.nl", "func twice(int x) -> int { ret x + x }\n");
+    NOVA_CHECK(queries.diagnostics("main.nl").empty());
+    NOVA_CHECK(queries.diagnostics("twice.nl").empty());
+
+    queries.setText("twice.nl", "func double(int x) -> int { ret x + x }\n");
+    NOVA_CHECK(mentions(queries.diagnostics("main.nl"), "twice"));
+
+    queries.setText("twice.nl", "func twice(int x, int y) -> int { ret x + y }\n");
+    NOVA_CHECK(mentions(queries.diagnostics("main.nl"), "expects 2 arguments"));
+
+    queries.setText("twice.nl", "func twice(int x) -> int { ret x * 2 }\n");
+    NOVA_CHECK(queries.diagnostics("main.nl").empty());
+}
+
+NOVA_TEST(signaturesFollowARecycledContext) {
+    Compiler compiler{BuildOptions{}};
+    addProject(compiler);
+    auto& queries = compiler.queries();
+
+    queries.setText("twice.nl", "func twice(int x) -> int { ret x * 2 }\n");
+    queries.setText("main.nl", "func main() -> int { ret twice(21) }\n");
+
+    auto symbol = queries.lookup("main.nl", "twice");
+    NOVA_REQUIRE(symbol && symbol->type != nullptr);
+    NOVA_CHECK(symbol->file == "twice.nl");
+    NOVA_CHECK(&symbol->type->getContext() == &compiler.llvmContext());
+
+    // Types of the old context would dangle, they have to be resolved again
+    compiler.recycleContext();
+    symbol = queries.lookup("main.nl", "twice");
+    NOVA_REQUIRE(symbol && symbol->type != nullptr);
+    NOVA_CHECK(&symbol->type->getContext() == &compiler.llvmContext());
+    NOVA_CHECK(symbol->type->getNumParams() == 1);
+}
+
+NOVA_TEST(closedBuffersFallBackToDisk) {
+    Compiler compiler{BuildOptions{}};
+    addProject(compiler);
+    auto& queries = compiler.queries();
+
+    queries.setText("twice.nl", "func twice(int x) -> int { ret x * 2 }\n");
+    NOVA_CHECK(queries.readable("twice.nl"));
+
+    queries.closeText("twice.nl");
+    NOVA_CHECK(!queries.readable("twice.nl"));
+    NOVA_CHECK(queries.declarations("twice.nl").empty());
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Minimal self registering test cases, run by main.cpp and registered with CTest as one executable
+namespace Nova::Tests {
+
+    struct TestCase {
+        const char* name;
+        std::function<void()> run;
+    };
+
+    inline std::vector<TestCase>& registry() {
+        static std::vector<TestCase> tests;
+        return tests;
+    }
+
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+
+    inline bool add(const char* name, std::function<void()> run) {
+        registry().push_back(TestCase{name, std::move(run)});
+        return true;
+    }
+
+    inline void fail(const char* file, int line, const std::string& message) {
+        fmt::print(stderr, "  {}:{}: {}\n", file, line, message);
+        failures()++;
+    }
+
+} // namespace Nova::Tests
+
+#define NOVA_TEST(name)                                                         \
+    static void name();                                                         \
+    static const bool name##Registered = ::Nova::Tests::add(#name, name);       \
+    static void name()
+
+// Failures are counted and the test goes on, one run shows every broken expectation
+#define NOVA_CHECK(condition)                                                   \
+    do {                                                                        \
+        if (!(condition)) ::Nova::Tests::fail(__FILE__, __LINE__, #condition); \
+    } while (false)
+
+// Stops the test when a later check would dereference what failed here
+#define NOVA_REQUIRE(condition)                                                 \
+    do {                                                                        \
+        if (!(condition)) {                                                     \
+            ::Nova::Tests::fail(__FILE__, __LINE__, #condition);               \
+            return;                                                             \
+        }                                                                       \
+    } while (false)